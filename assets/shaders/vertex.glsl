@@ -1,6 +1,7 @@
 #version 410 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec4 aColor;
+layout (location = 2) in uint aCellID;
 
 out vec3 color;
 
@@ -8,7 +9,22 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Compact vertices are fixed-point offsets from their chunk's origin, while
+// float vertices use a scale of 1 and an origin of 0
+uniform float positionScale;
+uniform vec2 chunkOrigin;
+
+// Cell ID vertices don't carry a color; it's fetched from one RGBA8 texel per cell
+uniform bool useCellColors;
+uniform samplerBuffer cellColors;
+
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    color = aColor;
+    vec2 position = chunkOrigin + (aPos / positionScale);
+    gl_Position = projection * view * model * vec4(position, 0.0, 1.0);
+    if (useCellColors) {
+        color = texelFetch(cellColors, int(aCellID)).rgb;
+    }
+    else {
+        color = aColor.rgb;
+    }
 }
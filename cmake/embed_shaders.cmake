@@ -0,0 +1,26 @@
+# Writes every .glsl file in SHADER_DIR into a header at OUTPUT as raw string
+# literals, so the program doesn't need its shader files at runtime.
+# Run with cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P embed_shaders.cmake
+file(GLOB SHADER_FILES ${SHADER_DIR}/*.glsl)
+list(SORT SHADER_FILES)
+
+set(ENTRIES "")
+foreach(SHADER_FILE ${SHADER_FILES})
+    get_filename_component(SHADER_NAME ${SHADER_FILE} NAME)
+    file(READ ${SHADER_FILE} SHADER_SOURCE)
+    string(APPEND ENTRIES "    {\"${SHADER_NAME}\", R\"madoc_glsl(${SHADER_SOURCE})madoc_glsl\"},\n")
+endforeach()
+
+file(WRITE ${OUTPUT} "#pragma once
+
+// Generated from assets/shaders by cmake/embed_shaders.cmake; don't edit
+
+
+struct EmbeddedShader {
+    const char* name;
+    const char* source;
+};
+
+constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+${ENTRIES}};
+")
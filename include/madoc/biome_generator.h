@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -14,12 +17,128 @@ struct WorldInfo {
 };
 
 
-std::vector<float> generateBiomeColor(float x, float y, int seed);
+// Hillshading lights the land from the northwest, 45 degrees up, as if the
+// whole range of elevation stood this many world units tall. Cells facing the
+// light get brighter than flat ground, and cells facing away get darker.
+constexpr glm::vec3 HILLSHADE_LIGHT_DIRECTION = {-0.5f, 0.5f, 0.70710678f};
+constexpr float HILLSHADE_RELIEF = 50.0f;
+
+// Number of equal steps each axis of the biome lookup table is quantized into
+// before the exact threshold test. No two thresholds on an axis can fall in
+// the same step.
+constexpr int BIOME_AXIS_RESOLUTION = 1024;
+
+// The kind of ground a biome is, from lowest to highest
+enum BiomeTerrain {
+    SEA_TERRAIN,
+    LAND_TERRAIN,
+    MOUNTAIN_TERRAIN,
+    IMPASSABLE_TERRAIN,
+    NUM_BIOME_TERRAINS
+};
+
+/*
+ * A biome as defined in the biome data file. Each range includes its min but
+ * not its max, and color is rgb from 0 to 1.
+ */
+struct Biome {
+    std::string name;
+    BiomeTerrain terrain;
+    float minElevation, maxElevation;
+    float minTemperature, maxTemperature;
+    float minPrecipitation, maxPrecipitation;
+    std::vector<float> color;
+};
+
+/*
+ * Maps values along one axis of the lookup table to the interval between the
+ * sorted thresholds that they're in. A value in step i of
+ * BIOME_AXIS_RESOLUTION is in interval baseInterval[i], or the next one if
+ * it's at least splitValue[i] (the one threshold that can fall inside a step).
+ */
+struct BiomeAxis {
+    std::vector<float> thresholds;
+    int numIntervals;
+    std::vector<int> baseInterval;
+    std::vector<float> splitValue;
+};
+
+/*
+ * The biomes compiled into a dense 3D table holding the biome of every
+ * combination of elevation, temperature and precipitation interval, laid out
+ * elevation-major. packedColors is the RGBA8 color of each biome.
+ *
+ * seaLevel, mountainLevel and impassableLevel are the elevations where land,
+ * mountains and impassable mountains start: the lowest elevation of any biome
+ * of that terrain or a higher one. Cells below seaLevel are sea. A terrain
+ * without biomes starts above any elevation.
+ */
+struct BiomeTable {
+    std::vector<Biome> biomes;
+    float seaLevel, mountainLevel, impassableLevel;
+    BiomeAxis elevationAxis, temperatureAxis, precipitationAxis;
+    std::vector<u_int8_t> biomeIDs;
+    std::vector<u_int8_t> packedColors;
+};
+
+/*
+ * Reads the biome definitions from a data file and compiles them into a
+ * lookup table. Throws if the file can't be read or parsed, if some
+ * combination of elevation, temperature and precipitation has no biome, or if
+ * a biome reaches above where a higher terrain starts.
+ */
+BiomeTable loadBiomeTable(const std::string& filePath);
+
+/*
+ * Looks up the biome of a single cell, the same way classifyBiomes() does
+ */
+u_int8_t classifyBiome(const BiomeTable& biomeTable, float elevation, float temperature,
+    float precipitation);
+
+/*
+ * Looks up the biome of every cell. Each lookup is a handful of clamps,
+ * compares and table reads with no branches, so it costs the same no matter
+ * how many biomes there are.
+ */
+void classifyBiomes(const BiomeTable& biomeTable, const std::vector<float>& elevation,
+    const std::vector<float>& temperature, const std::vector<float>& precipitation,
+    std::vector<u_int8_t>& cellBiomes);
+
+/*
+ * Writes the packed RGBA8 color of every cell's biome into cellColors, in the
+ * layout packCellColor() uses
+ */
+void packBiomeColors(const BiomeTable& biomeTable, const std::vector<u_int8_t>& cellBiomes,
+    std::vector<u_int8_t>& cellColors);
+
+/*
+ * Returns the elevation at each of the given world space positions for the
+ * given seed
+ */
+std::vector<float> generateCellElevations(const std::vector<glm::vec2>& positions, int seed);
+
+/*
+ * Same as above, but also writes the gradient of the elevation (per world
+ * unit, along x and y) at each position, from the same noise samples
+ */
+std::vector<float> generateCellElevations(const std::vector<glm::vec2>& positions, int seed,
+    std::vector<glm::vec2>& gradients);
+
+/*
+ * Returns how brightly each cell is lit under HILLSHADE_LIGHT_DIRECTION,
+ * where 1 is flat ground. The sea (below seaLevel) is always 1.
+ */
+std::vector<float> getHillshades(const std::vector<float>& elevation,
+    const std::vector<glm::vec2>& gradients, float seaLevel);
+
+/*
+ * Multiplies the rgb of a cell's packed color by shade
+ */
+void shadeCellColor(std::vector<u_int8_t>& cellColors, int cellID, float shade);
 
 float generateTemperature(float y, float worldHeight, float tempMult);
 
-float generateElevation(std::array<int, 512>& permutationTable,
-                        std::array<glm::vec2, 32>& gradientVectors, float x, float y);
+float generateElevation(const std::array<int, 512>& permutationTable, float x, float y);
 
-float generatePrecipitation(std::array<int, 512>& permutationTable,
-                            std::array<glm::vec2, 32>& gradientVectors, float x, float y);
+float generateElevation(const std::array<int, 512>& permutationTable, float x, float y,
+                        glm::vec2& gradient);
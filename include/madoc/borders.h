@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <madoc/delaunay.h>
+#include <madoc/regions.h>
+#include <madoc/voronoi.h>
+
+
+/*
+ * What a border separates, from least to most important. A segment gets the
+ * most important type that applies to it, and more important types are drawn
+ * on top.
+ */
+enum BorderType {
+    CELL_BORDER,
+    PROVINCE_BORDER,
+    NATION_BORDER,
+    COAST_BORDER,
+    NUM_BORDER_TYPES
+};
+
+// Cell borders are hidden once cells get closer together than this many
+// screen pixels, where they would only blur into a grid
+constexpr float MIN_CELL_BORDER_PIXELS = 4.0f;
+
+/*
+ * A straight piece of the boundary between two neighboring cells, in world
+ * space. cellA is always the lower voronoiID.
+ */
+struct BorderSegment {
+    int cellA, cellB;
+    glm::vec2 from, to;
+};
+
+/*
+ * Line mesh of every border segment (pairs of x, y, z, r, g, b vertices for
+ * GL_LINES), sorted by type so each type is one contiguous range of vertices
+ * that can be shown or hidden on its own.
+ *
+ * Each segment takes up one slot of two vertices. segmentTypes and
+ * segmentSlots are the type and slot of each segment, and slotSegments the
+ * segment in each slot, so a segment can be retagged in place. Cell i's
+ * segments are cellSegments[cellSegmentOffsets[i]] up to
+ * cellSegments[cellSegmentOffsets[i + 1]].
+ */
+struct BorderMesh {
+    std::vector<float> vertices;
+    std::array<int, NUM_BORDER_TYPES> firstVertex;
+    std::array<int, NUM_BORDER_TYPES> numVertices;
+    float averageSegmentLength;
+    std::vector<u_int8_t> segmentTypes;
+    std::vector<int> segmentSlots;
+    std::vector<int> slotSegments;
+    std::vector<int> cellSegmentOffsets;
+    std::vector<int> cellSegments;
+};
+
+/*
+ * Returns every edge two voronoi cells share, once each, from their exact
+ * polygons. Edges on the edge of the world aren't shared, so they're left out.
+ */
+std::vector<BorderSegment> getVoronoiBorderSegments(const VoronoiGrid& inputGrid,
+    const DelaunayTriangulation& triangulation,
+    const std::vector<std::vector<int>>& cellNeighbors);
+
+/*
+ * Returns every edge two labeled cells share on the grid, once each, with
+ * straight runs along a row or column merged into one segment
+ */
+std::vector<BorderSegment> getGridBorderSegments(const VoronoiGrid& inputGrid);
+
+/*
+ * Tags each segment with its type and builds the line mesh. Cells are land
+ * or sea by isLandCell, and belong to the provinces and nations grown by
+ * generateRegions() (nations being grown over the provinces).
+ */
+BorderMesh createBorderMesh(const std::vector<BorderSegment>& segments,
+    const std::vector<bool>& isLandCell, const RegionMap& provinces, const RegionMap& nations);
+
+/*
+ * Tags the segments of the given cells again, after some of them went from
+ * land to sea or back, and moves each segment whose type changed into the
+ * range of its new type. Segments are moved by swapping them across the
+ * boundaries between ranges, so only a few slots per segment are rewritten.
+ * Returns the slots that were, in no particular order.
+ */
+std::vector<int> retagBorderSegments(BorderMesh& mesh, const std::vector<BorderSegment>& segments,
+    const std::vector<int>& cells, const std::vector<bool>& isLandCell,
+    const RegionMap& provinces, const RegionMap& nations);
+
+/*
+ * Re-uploads numSlots slots of the mesh starting at firstSlot into the VBO,
+ * which holds the mesh in the float vertex format. Only that range of the
+ * buffer is touched. Throws if the range is out of bounds.
+ */
+void updateBorderMeshSlots(const BorderMesh& mesh, GLuint VBO, int firstSlot, int numSlots);
+
+/*
+ * Draws the visible types of border from a bound vertex array holding the
+ * border mesh in the float vertex format. Cell borders are skipped when
+ * they're too dense to read at the given zoom.
+ */
+void drawBorderMesh(const BorderMesh& mesh, const std::array<bool, NUM_BORDER_TYPES>& isVisible,
+    float pixelsPerUnit);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+
+/*
+ * A 2D orthographic camera looking down at the world. position is the world
+ * space point in the middle of the screen, and zoom is how many screen pixels
+ * one grid unit takes up.
+ */
+struct Camera {
+    glm::vec2 position;
+    float zoom;
+    float minZoom, maxZoom;
+};
+
+/*
+ * Creates a camera centered on the world and zoomed out just enough that the
+ * whole world fits on screen.
+ */
+Camera createCamera(int worldWidth, int worldHeight, int screenWidth, int screenHeight);
+
+glm::mat4 getViewMatrix(const Camera& camera);
+
+glm::mat4 getProjectionMatrix(const Camera& camera, int screenWidth, int screenHeight);
+
+/*
+ * Gets the world space rectangle that's currently visible on screen
+ */
+void getCameraBounds(const Camera& camera, int screenWidth, int screenHeight,
+    glm::vec2& boundsMin, glm::vec2& boundsMax);
+
+/*
+ * Converts a position in screen (framebuffer) pixels, with the origin at the
+ * top left, into world space. GLFW's cursor position is in window coordinates,
+ * which have to be scaled to framebuffer pixels first on high DPI displays.
+ */
+glm::vec2 screenToWorld(const Camera& camera, int screenWidth, int screenHeight,
+    glm::vec2 screenPosition);
+
+/*
+ * Moves the camera by the given amount of screen pixels
+ */
+void panCamera(Camera& camera, glm::vec2 screenDelta);
+
+/*
+ * Multiplies the zoom by the given factor, keeping the world space anchor
+ * point in the same spot on screen.
+ */
+void zoomCamera(Camera& camera, float factor, glm::vec2 anchor);
+
+/*
+ * Returns whether an axis-aligned world space box overlaps the camera bounds
+ */
+bool isBoxVisible(glm::vec2 boxMin, glm::vec2 boxMax, glm::vec2 boundsMin, glm::vec2 boundsMax);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+
+/*
+ * Per-cell attributes that live on the GPU instead of in the vertex buffer.
+ * Each cell gets one RGBA8 texel in a buffer texture, which the vertex shader
+ * indexes with the cell ID of the vertex it's processing. Recoloring a cell
+ * only rewrites its 4 bytes here.
+ */
+struct CellAttributeBuffer {
+    GLuint buffer;
+    GLuint texture;
+    int numCells;
+};
+
+/*
+ * Converts a float rgb color into RGBA8 and writes it into a list of packed
+ * cell colors at the given cell ID.
+ */
+void packCellColor(std::vector<u_int8_t>& cellColors, int cellID, const std::vector<float>& color);
+
+/*
+ * Creates the buffer and buffer texture for the given packed RGBA8 cell colors
+ */
+CellAttributeBuffer createCellAttributeBuffer(const std::vector<u_int8_t>& cellColors);
+
+/*
+ * Uploads numCells packed colors starting at firstCell. Only that range of
+ * the buffer is touched.
+ */
+void updateCellColors(const CellAttributeBuffer& attributeBuffer,
+    const std::vector<u_int8_t>& cellColors, int firstCell, int numCells);
+
+/*
+ * Binds the buffer texture to the given texture unit and points the shader's
+ * cellColors sampler at it. The shader program must already be in use.
+ */
+void bindCellAttributeBuffer(const CellAttributeBuffer& attributeBuffer,
+    GLint samplerLocation, int textureUnit);
+
+/*
+ * Frees the buffer and texture of the attribute buffer
+ */
+void deleteCellAttributeBuffer(CellAttributeBuffer& attributeBuffer);
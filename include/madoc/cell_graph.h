@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include <madoc/voronoi.h>
+
+
+/*
+ * Adjacency graph of the voronoi cells in compressed sparse row form. The
+ * neighbors of cell i are neighbors[offsets[i]] up to neighbors[offsets[i + 1]].
+ */
+struct CellGraph {
+    int numCells;
+    std::vector<int> offsets;
+    std::vector<int> neighbors;
+};
+
+/*
+ * Packs per-cell neighbor lists (like getDelaunayNeighbors() returns) into a
+ * CellGraph
+ */
+CellGraph createCellGraph(const std::vector<std::vector<int>>& neighborLists);
+
+/*
+ * Builds the CellGraph of a labeled grid, where two cells are neighbors if
+ * any of their grid cells touch along an edge
+ */
+CellGraph createGridCellGraph(const VoronoiGrid& inputGrid);
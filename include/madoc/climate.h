@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/cell_graph.h>
+
+
+// Latitude bands per hemisphere, each with its own prevailing wind: easterly
+// trade winds, westerlies, then polar easterlies
+constexpr int WIND_BANDS_PER_HEMISPHERE = 3;
+// A cell whose upwind neighbors are all in another band takes its air from
+// the nearest cell upwind in its own band, if one is within this many times
+// the distance to its furthest neighbor
+constexpr float CLIMATE_CARRY_RANGE = 2.0f;
+// Fraction of the moisture in the air that rains out per grid unit travelled
+// over land, even on flat ground
+constexpr float BASE_RAIN_RATE = 0.01f;
+// How fast the moisture air can hold drops as the land under it rises
+// (saturation per unit of elevation above sea level)
+constexpr float MOISTURE_LAPSE_RATE = 4.0f;
+
+/*
+ * Per-cell climate. temperature and precipitation go from 0 to 1 and are what
+ * biomes are picked by; precipitation is how much moisture the wind brings to
+ * the cell. rainfall is how much of that moisture falls on each grid unit of
+ * the cell, for the hydrology model.
+ */
+struct Climate {
+    std::vector<float> temperature;
+    std::vector<float> precipitation;
+    std::vector<float> rainfall;
+};
+
+/*
+ * Works out the climate of every cell. Air leaves the sea saturated and is
+ * blown across the cell graph by the prevailing wind of its latitude band,
+ * raining out as it goes and losing whatever it can no longer hold as the land
+ * rises, which leaves rain shadows behind mountains. Each band is swept in the
+ * direction of its wind in one pass, and the bands run in parallel. Cells
+ * below seaLevel are sea, and cellCentroids are in world space.
+ */
+Climate generateClimate(const CellGraph& graph, const std::vector<glm::vec2>& cellCentroids,
+    const std::vector<float>& elevation, float seaLevel, int worldWidth, int worldHeight);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/voronoi.h>
+
+
+// Used as the neighborID of an outline chain that runs along the edge of the world
+constexpr int WORLD_EDGE = -1;
+
+/*
+ * A piece of a voronoi cell's outline between two junctions. Junctions are
+ * grid corners where 3 or more cells (counting the outside of the world as a
+ * cell) meet, plus the corners of the world. Every chain separates exactly two
+ * cells, and both of them trace it point for point, just in opposite orders.
+ */
+struct OutlineChain {
+    int neighborID;
+    std::vector<glm::vec2> points;
+};
+
+/*
+ * Traces the outline of a cell along the corners of its grid cells, rather than
+ * through their centers like getEdgeVertices() does. That way neighboring cells
+ * share their borders exactly. Returns one point per grid corner in clockwise
+ * order (on screen), in grid coordinates where y points down.
+ */
+std::vector<glm::ivec2> traceCellCorners(const VoronoiBitmask& bitmask);
+
+/*
+ * Returns whether the given grid corner is a junction of the voronoi grid
+ */
+bool isJunction(const VoronoiGrid& inputGrid, int cornerX, int cornerY);
+
+/*
+ * Simplifies an open polyline with the Douglas-Peucker algorithm. The first
+ * and last points are always kept, and every dropped point is within tolerance
+ * grid units of the result.
+ */
+std::vector<glm::vec2> simplifyDouglasPeucker(const std::vector<glm::vec2>& points,
+    float tolerance);
+
+/*
+ * Splits a cell's outline into chains at its junctions and merges their
+ * collinear runs. The chains aren't simplified yet, so one set of chains can
+ * be simplified at several tolerances without tracing the cell again.
+ */
+std::vector<OutlineChain> getOutlineChains(const VoronoiGrid& inputGrid,
+    const VoronoiBitmask& bitmask, u_int16_t voronoiID);
+
+/*
+ * Simplifies each chain with simplifyDouglasPeucker(). Chains are always
+ * simplified in the same canonical direction, so a border shared by two cells
+ * gets simplified identically from both sides and no cracks open up between them.
+ */
+std::vector<OutlineChain> simplifyOutlineChains(const std::vector<OutlineChain>& chains,
+    float tolerance);
+
+/*
+ * Joins a cell's chains back into one closed outline of x, y, z vertices, in
+ * the same space and order as getEdgeVertices().
+ */
+std::vector<float> getChainVertices(const std::vector<OutlineChain>& chains);
+
+/*
+ * Drop-in replacement for getEdgeVertices() that returns the simplified outline
+ * of a cell.
+ */
+std::vector<float> getSimplifiedEdgeVertices(const VoronoiGrid& inputGrid,
+    const VoronoiBitmask& bitmask, u_int16_t voronoiID, float tolerance);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/voronoi.h>
+
+
+/*
+ * Delaunay triangulation of a set of points. triangles holds 3 point indices
+ * per triangle. Each entry of triangles is also a half-edge, going from its
+ * point to the next point of the same triangle, and halfedges holds the index
+ * of the opposite half-edge in the neighboring triangle (or -1 on the convex
+ * hull). hull lists the points on the convex hull in order.
+ */
+struct DelaunayTriangulation {
+    std::vector<glm::dvec2> points;
+    std::vector<int> triangles;
+    std::vector<int> halfedges;
+    std::vector<int> hull;
+};
+
+/*
+ * Triangulates the given points with a radial sweep (the algorithm Delaunator
+ * uses): points are added in order of distance from a seed triangle, each one
+ * connected to the part of the convex hull it can see, and then edges are
+ * flipped until every triangle is Delaunay. Runs in O(n log n). Duplicate
+ * points are skipped, and fully collinear input produces no triangles.
+ */
+DelaunayTriangulation triangulateDelaunay(const std::vector<glm::dvec2>& points);
+
+/*
+ * Returns the Delaunay neighbors of every point, which are exactly the points
+ * whose voronoi cells share an edge with its cell.
+ */
+std::vector<std::vector<int>> getDelaunayNeighbors(const DelaunayTriangulation& triangulation);
+
+/*
+ * Returns the exact voronoi cell of a point as a convex polygon, by clipping
+ * the given bounds to the half of the plane closer to the point than to each
+ * of its Delaunay neighbors. The polygon is counterclockwise with y pointing up.
+ */
+std::vector<glm::dvec2> getVoronoiPolygon(const DelaunayTriangulation& triangulation,
+    const std::vector<int>& neighbors, int pointIndex, glm::dvec2 boundsMin, glm::dvec2 boundsMax);
+
+/*
+ * Triangulates every feature point of the grid, placing each one at the
+ * center of its grid cell, in the same corner coordinates (y pointing down)
+ * that traceCellCorners() uses. Point indices match voronoiIDs.
+ */
+DelaunayTriangulation triangulateFeaturePoints(const VoronoiGrid& inputGrid);
+
+/*
+ * Vector replacement for getSimplifiedEdgeVertices(): returns the exact
+ * outline of a voronoi cell, clipped to the world, as x, y, z vertices in the
+ * same space as getEdgeVertices(). It doesn't depend on the grid's resolution.
+ */
+std::vector<float> getVoronoiCellVertices(const VoronoiGrid& inputGrid,
+    const DelaunayTriangulation& triangulation, const std::vector<int>& neighbors,
+    u_int16_t voronoiID);
+
+/*
+ * Triangulates a convex polygon as a fan around its first vertex
+ */
+std::vector<unsigned int> getFanIndices(int numVertices);
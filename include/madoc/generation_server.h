@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+#include <madoc/biome_generator.h>
+#include <madoc/world_generator.h>
+
+
+/*
+ * A long-running server that generates worlds on request, so tools don't
+ * pay for process startup, the biome table and the thread pool every seed.
+ *
+ * Every message, both ways, is a u32 length followed by that many bytes of
+ * payload, and every value is in the machine's native byte order. Requests
+ * start with a u32 ServerMessageType:
+ *   GENERATE_MESSAGE: u32 requestID, then i32 seed, width, height,
+ *     macroWidth, macroHeight, minPoints and maxPoints
+ *   STATS_MESSAGE: nothing else
+ * Responses start with the u32 type and requestID (0 for stats) they answer,
+ * then a u32 ServerStatus. Anything but SERVER_OK is followed by a u32
+ * length and that many bytes of error message. An OK generate response
+ * holds, in order:
+ *   the label grid: i32 width, height, then width * height u16 voronoiIDs
+ *   the cells: i32 numCells, then numCells each of f32 elevation,
+ *     temperature and precipitation, u8 biome and RGBA8 color
+ *   the mesh: i32 numLods and numChunks, then per chunk per level of
+ *     detail its i32 firstIndex, numIndices, baseVertex and numVertices,
+ *     then u32 numVertices and that many of 6 f32 (xyz, rgb) and a u32 cell
+ *     ID, then u32 numIndices and that many u32 indices
+ * An OK stats response holds u32 queue depth, u64 requests completed and
+ * f64 p50, p90 and p99 latency in milliseconds (from a request being read to
+ * its response being written) over the last NUM_LATENCY_SAMPLES requests.
+ *
+ * Requests are answered as they finish, not in the order they came in.
+ */
+enum ServerMessageType {
+    GENERATE_MESSAGE = 1,
+    STATS_MESSAGE = 2
+};
+
+enum ServerStatus {
+    SERVER_OK = 0,
+    SERVER_ERROR = 1,
+    SERVER_BUSY = 2
+};
+
+// Requests past this many waiting are turned away as SERVER_BUSY instead of
+// queued, so a request that is accepted never waits behind more than this
+constexpr int MAX_QUEUED_REQUESTS = 64;
+// Worlds generated at once. Each one is already split across the thread pool,
+// so a couple is enough to fill the gaps where a stage runs on one thread.
+constexpr int NUM_REQUEST_WORKERS = 2;
+constexpr int NUM_LATENCY_SAMPLES = 1024;
+// Limits on what a request can ask for. Labeling the grid costs its area
+// times the points in each macro cell, so both are capped: at the caps a
+// world takes about 3 seconds and 120 MB on one core.
+constexpr u_int32_t MAX_REQUEST_LENGTH = 1024;
+constexpr int MAX_WORLD_AREA = 2048 * 2048;
+constexpr int MAX_POINTS_PER_MACRO_CELL = 16;
+// Fewer macro cells across or down than this could put every point on one
+// line, which has no triangulation
+constexpr int MIN_WORLD_MACRO_CELLS = 2;
+
+/*
+ * Serves generation requests until the input ends, reading them from stdin
+ * and answering on stdout if socketPath is empty, or from every client of a
+ * Unix socket created at socketPath otherwise (which never ends). Each world
+ * is generated with baseSettings, but with the request's size, macro size
+ * and point counts, random (not Poisson disk) point placement, and only what
+ * the response holds (see isMeshOnly). Returns the process exit code.
+ */
+int runGenerationServer(const WorldSettings& baseSettings, const BiomeTable& biomeTable,
+    const std::string& socketPath);
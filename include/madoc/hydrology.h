@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/biome_generator.h>
+#include <madoc/cell_graph.h>
+#include <madoc/voronoi.h>
+
+
+// How much higher than its downstream cell a filled cell is raised, so that
+// filled depressions still drain in a well-defined direction
+constexpr float FILL_EPSILON = 1e-5f;
+
+/*
+ * Where water goes on the cell graph. filledElevation is the elevation with
+ * every depression filled up to its spill point, and isLake marks the cells
+ * that filling raised. downstream is the neighbor each cell drains into (-1
+ * for outlets), and flow is how much rainfall passes through each cell.
+ */
+struct Hydrology {
+    std::vector<float> filledElevation;
+    std::vector<bool> isLake;
+    std::vector<int> downstream;
+    std::vector<float> flow;
+};
+
+/*
+ * Returns which cells water can leave the world through: sea cells (below
+ * seaLevel), and cells on the edge of the world
+ */
+std::vector<bool> getOutletCells(const VoronoiGrid& inputGrid,
+    const std::vector<float>& elevation, float seaLevel);
+
+/*
+ * Runs the whole hydrology model on the cell graph. Depressions are filled
+ * with a priority flood from the outlets, which also gives every cell the
+ * direction it drains in, in O(n log n). Flow is then accumulated downstream
+ * one level of the drainage tree at a time, with each level split across
+ * threads. rainfall is how much water each cell adds.
+ */
+Hydrology generateHydrology(const CellGraph& graph, const std::vector<float>& elevation,
+    const std::vector<bool>& isOutlet, const std::vector<float>& rainfall);
+
+/*
+ * Returns a line mesh (pairs of x, y, z, r, g, b vertices for GL_LINES) of
+ * every river: land cells (at or above seaLevel) with at least minFlow flowing
+ * through them, drawn from their centroid to their downstream cell's
+ * centroid. cellCentroids are in world space.
+ */
+std::vector<float> getRiverVertices(const Hydrology& hydrology,
+    const std::vector<glm::vec2>& cellCentroids, const std::vector<float>& elevation,
+    float seaLevel, float minFlow);
@@ -1,8 +1,108 @@
 #pragma once
 
-#include <string>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <type_traits>
 
-// Prints out formatted and standardized errors, warnings, and info
-void logError(const std::string& module, const std::string& message);
-void logWarning(const std::string& module, const std::string& message);
-void logInfo(const std::string& module, const std::string& message);
+
+enum LogLevel {
+    LOG_DEBUG = 0,
+    LOG_INFO = 1,
+    LOG_WARNING = 2,
+    LOG_ERROR = 3
+};
+
+// Messages below this level are compiled out entirely. Set with the
+// MADOC_LOG_LEVEL CMake option.
+#ifndef MADOC_LOG_LEVEL
+#define MADOC_LOG_LEVEL 1
+#endif
+constexpr LogLevel MIN_LOG_LEVEL = static_cast<LogLevel>(MADOC_LOG_LEVEL);
+
+// Records each thread can have waiting to be written before new ones are
+// dropped (and counted) rather than making the thread wait
+constexpr int LOG_RING_SIZE = 1024;
+// Most fields a record can carry, and how much of its module and message fit
+// in the record itself; longer text is copied to the heap instead
+constexpr int MAX_LOG_FIELDS = 4;
+constexpr int LOG_INLINE_TEXT_SIZE = 144;
+// How often the background thread writes out waiting records, at most. Warnings
+// and errors wake it right away.
+constexpr int LOG_FLUSH_INTERVAL_MS = 10;
+
+enum LogFieldType {
+    LOG_INT_FIELD,
+    LOG_FLOAT_FIELD,
+    LOG_MILLISECONDS_FIELD
+};
+
+/*
+ * A named value attached to a log message, like a seed or how long a stage
+ * took, written out as name=value after it. name has to outlive the program
+ * (a string literal), since only the pointer is kept. Durations are written
+ * in milliseconds.
+ */
+struct LogField {
+    const char* name;
+    LogFieldType type;
+    union {
+        int64_t intValue;
+        double floatValue;
+    };
+
+    LogField() = default;
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    LogField(const char* fieldName, const T value) :
+        name(fieldName), type(LOG_INT_FIELD), intValue(static_cast<int64_t>(value)) {}
+
+    template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    LogField(const char* fieldName, const T value) :
+        name(fieldName), type(LOG_FLOAT_FIELD), floatValue(static_cast<double>(value)) {}
+
+    template <typename Rep, typename Period>
+    LogField(const char* fieldName, const std::chrono::duration<Rep, Period> value) :
+        name(fieldName), type(LOG_MILLISECONDS_FIELD),
+        floatValue(std::chrono::duration<double, std::milli>(value).count()) {}
+};
+
+/*
+ * Copies a message into the calling thread's ring of log records, without
+ * formatting it or taking any locks (besides the first time a thread logs),
+ * for a background thread to write to stderr. If the ring is full the message
+ * is dropped. Use MADOC_LOG() instead, which compiles out filtered levels.
+ */
+void pushLogRecord(LogLevel level, std::string_view module, std::string_view message,
+    std::initializer_list<LogField> fields);
+
+/*
+ * Logs a message from a module with up to MAX_LOG_FIELDS LogFields after it,
+ * like MADOC_LOG(LOG_INFO, "main", "Generated", {"seed", seed}), as
+ * "[LEVEL] [module] message name=value ...". Messages from one thread are
+ * written in order, and messages from different threads in the order they
+ * were logged. It's a macro so that below MIN_LOG_LEVEL the message and
+ * fields aren't even evaluated, and building them costs nothing either.
+ */
+#define MADOC_LOG(level, module, message, ...) \
+    do { \
+        if constexpr ((level) >= MIN_LOG_LEVEL) { \
+            pushLogRecord((level), (module), (message), {__VA_ARGS__}); \
+        } \
+    } while (false)
+
+// Prints out formatted and standardized errors, warnings, and info. The
+// message is passed in already built, so messages that have to be put
+// together should use MADOC_LOG() instead.
+inline void logError(const std::string_view module, const std::string_view message) {
+    MADOC_LOG(LOG_ERROR, module, message);
+}
+
+inline void logWarning(const std::string_view module, const std::string_view message) {
+    MADOC_LOG(LOG_WARNING, module, message);
+}
+
+inline void logInfo(const std::string_view module, const std::string_view message) {
+    MADOC_LOG(LOG_INFO, module, message);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+
+// Size of the post-transform vertex cache that orderings are optimized and
+// measured against. Real GPUs vary, but 16-32 entries is the usual range.
+constexpr int VERTEX_CACHE_SIZE = 16;
+
+/*
+ * Reorders the triangles of an index buffer so that vertices get reused while
+ * they're still in the GPU's post-transform cache (Forsyth's algorithm). The
+ * triangles themselves and their winding are unchanged.
+ */
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices,
+    int numVertices);
+
+/*
+ * Renumbers vertices in the order that the index buffer first uses them, so
+ * vertex fetches walk through memory linearly. Rewrites the given indices and
+ * returns the remap table, where remap[oldIndex] = newIndex. Vertices that are
+ * never referenced are moved to the end.
+ */
+std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices,
+    int numVertices);
+
+/*
+ * Moves the vertex data to match a remap table from optimizeVertexFetch().
+ * componentsPerVertex is how many elements of the vector each vertex takes up.
+ */
+template <typename T>
+void remapVertices(std::vector<T>& vertices, const int componentsPerVertex,
+    const std::vector<unsigned int>& remap) {
+    std::vector<T> remappedVertices(vertices.size());
+    for (int i = 0; i < remap.size(); i++) {
+        for (int j = 0; j < componentsPerVertex; j++) {
+            remappedVertices[(remap[i] * componentsPerVertex) + j] =
+                vertices[(i * componentsPerVertex) + j];
+        }
+    }
+    vertices.swap(remappedVertices);
+}
+
+/*
+ * Average cache miss ratio: vertex shader invocations per triangle when drawn
+ * through a FIFO cache of the given size. 3.0 is the worst case; ~0.5-0.7 is
+ * about as good as a regular 2D mesh gets.
+ */
+float getACMR(const std::vector<unsigned int>& indices, int cacheSize);
+
+/*
+ * Average transform to vertex ratio: vertex shader invocations per unique
+ * vertex. 1.0 means every vertex is only ever transformed once.
+ */
+float getATVR(const std::vector<unsigned int>& indices, int numVertices, int cacheSize);
@@ -8,6 +8,22 @@
 #include <glm/gtc/type_ptr.hpp>
 
 
+/*
+ * Settings of a sum of octaves of perlin noise. Each octave has persistence
+ * times the amplitude and lacunarity times the frequency of the one before,
+ * and the sum is divided by the total amplitude.
+ */
+struct OctaveSettings {
+    int octaves;
+    float amplitude, frequency, persistence, lacunarity;
+};
+
+// The octaves the elevation of the world is sampled with
+constexpr OctaveSettings ELEVATION_OCTAVES = {4, 1.0f, 0.01f, 0.5f, 2.0f};
+
+/*
+ * Returns the 32 gradient unit vectors, which are worked out at compile time
+ */
 std::array<glm::vec2, 32> generateGradients();
 
 std::array<int, 512> generatePermutationTable(int seed);
@@ -16,12 +32,48 @@ float dotGridGradient(float xSample, float zSample, int xCorner, int yCorner);
 
 float fade(float t);
 
+/*
+ * Derivative of fade(), which is 0 at both ends just like fade() is flat there
+ */
+float fadeDerivative(float t);
+
 float lerp(float a, float b, float t);
 
-float samplePerlin(std::array<int, 512>& permutationTable,
-                   std::array<glm::vec2, 32>& gradientVectors, float x, float z);
+float samplePerlin(const std::array<int, 512>& permutationTable,
+                   const std::array<glm::vec2, 32>& gradientVectors, float x, float z);
+
+/*
+ * Samples octaves of noise whose settings are fixed at compile time, with
+ * the built-in gradient vectors. The octaves are unrolled, and their
+ * amplitudes, frequencies and normalization are constants. Only the presets
+ * above are instantiated, in perlin_noise.cpp.
+ */
+template <OctaveSettings settings>
+float samplePerlinOctaves(const std::array<int, 512>& permutationTable, float x, float z);
+
+/*
+ * Samples the noise and its analytic derivative at the same time, returning
+ * (value, d/dx, d/dz). The value is exactly what samplePerlin() returns.
+ */
+glm::vec3 samplePerlinWithDerivative(const std::array<int, 512>& permutationTable,
+                                     const std::array<glm::vec2, 32>& gradientVectors,
+                                     float x, float z);
+
+/*
+ * Like samplePerlinOctaves<settings>(), but also sums up the octaves'
+ * derivatives in the same pass, returning (value, d/dx, d/dz). The value is
+ * exactly what samplePerlinOctaves<settings>() returns.
+ */
+template <OctaveSettings settings>
+glm::vec3 samplePerlinOctavesWithDerivative(const std::array<int, 512>& permutationTable,
+                                            float x, float z);
 
-float samplePerlinOctaves(std::array<int, 512>& permutationTable,
-                          std::array<glm::vec2, 32>& gradientVectors, float x,
+/*
+ * Samples octaves of noise whose settings are only known at run time. Up to 8
+ * octaves are dispatched to unrolled kernels, which give the same result as
+ * the plain loop that handles the rest.
+ */
+float samplePerlinOctaves(const std::array<int, 512>& permutationTable,
+                          const std::array<glm::vec2, 32>& gradientVectors, float x,
                           float z, int octaves, float amplitude, float frequency,
                           float persistence, float lacunarity);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/biome_generator.h>
+#include <madoc/cell_graph.h>
+
+
+// How much it costs to grow a region across each kind of terrain, per grid
+// unit, relative to open land
+constexpr float MOUNTAIN_TERRAIN_COST = 4.0f;
+constexpr float IMPASSABLE_TERRAIN_COST = 12.0f;
+constexpr float SEA_TERRAIN_COST = 6.0f;
+
+/*
+ * Cells grouped into regions, like provinces or nations. cellRegions is the
+ * region of each cell, or -1 for cells no region claims. Each region has the
+ * cell it grew from, its total area, its area-weighted centroid and terrain
+ * cost, and regionGraph says which regions border each other, so the regions
+ * can be grouped again into bigger ones.
+ */
+struct RegionMap {
+    int numRegions;
+    std::vector<int> cellRegions;
+    std::vector<int> seedCells;
+    std::vector<float> regionAreas;
+    std::vector<glm::vec2> regionCentroids;
+    std::vector<float> regionCosts;
+    CellGraph regionGraph;
+};
+
+/*
+ * Returns how much it costs to grow a region across each cell, by the terrain
+ * its elevation is in according to the biome table: mountains and sea are
+ * expensive to cross
+ */
+std::vector<float> getTerrainCosts(const std::vector<float>& elevation,
+    const BiomeTable& biomeTable);
+
+/*
+ * Groups the cells of the graph into numRegions regions. Seed cells are
+ * picked at random among the claimable cells, spread apart from each other,
+ * then every region grows outwards from its seed at the same time; each cell
+ * joins the region that can reach it cheapest, where crossing between two
+ * cells costs the distance between their positions times their average cost.
+ * Regions can cross unclaimable cells, but only claimable ones are part of
+ * them.
+ *
+ * The growth is a delta-stepping shortest path search split across threads.
+ * Ties go to the lower region ID, so the result is the same for a given seed
+ * no matter how many threads run it.
+ */
+RegionMap generateRegions(const CellGraph& graph, const std::vector<glm::vec2>& positions,
+    const std::vector<float>& cellCosts, const std::vector<float>& cellAreas,
+    const std::vector<bool>& isClaimable, int numRegions, int seed);
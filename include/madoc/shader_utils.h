@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <string>
 
 #include <glad/glad.h>
@@ -10,11 +11,43 @@ enum ShaderType {
     FRAGMENT
 };
 
+/*
+ * Locations of the uniforms used by the world shader. Looking these up is
+ * slow-ish, so it's done once after the program is linked.
+ */
+struct ShaderUniforms {
+    GLint model, view, projection;
+    GLint positionScale, chunkOrigin;
+    GLint useCellColors, cellColors;
+};
+
 // Take a file path as input, and output a string of the text in that file
 std::string readShaderFile(const std::string& filePath);
 
+/*
+ * Returns the source of a shader in assets/shaders by its file name (like
+ * "vertex.glsl"). Shaders are built into the program, but if
+ * overrideDirectory isn't empty they're read from there instead, so they can
+ * be edited without rebuilding.
+ */
+std::string getShaderSource(const std::string& name, const std::string& overrideDirectory);
+
 // Generate a shader based on the source code and shader type
 GLuint createShader(const char* shaderSource, ShaderType shaderType);
 
-// Generate a shaderProgram based on the given lists of individual shaders
-GLuint createShaderProgram(GLuint shaderList[]);
+// Generate a shaderProgram based on the given list of individual shaders,
+// which are deleted once it's linked
+GLuint createShaderProgram(std::span<const GLuint> shaderList);
+
+/*
+ * Compiles and links a program from vertex and fragment shader source, unless
+ * the binary cached at cachePath was linked from the same source by the same
+ * driver, in which case that's loaded instead and nothing is compiled. On a
+ * miss the cache is rewritten. An empty cachePath (or a driver with no binary
+ * formats) turns the cache off.
+ */
+GLuint loadShaderProgram(const std::string& vertexSource, const std::string& fragmentSource,
+    const std::string& cachePath);
+
+// Look up the locations of all of the world shader's uniforms
+ShaderUniforms getShaderUniforms(GLuint shaderProgram);
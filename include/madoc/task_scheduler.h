@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+
+/*
+ * Every generation stage shares one pool of worker threads, one per core
+ * besides the thread that starts the work. Each worker has its own queue of
+ * tasks and steals from the others' when it runs out, and a thread waiting on
+ * tasks runs queued ones until its own are done, so work can be started from
+ * inside other work without blocking a thread.
+ */
+
+/*
+ * How many threads run work at once, counting the one that waits on it
+ */
+int getNumWorkerThreads();
+
+/*
+ * Calls body(chunkBegin, chunkEnd) for every chunk of grainSize indices
+ * (the last one can be smaller) from begin up to end, in parallel, and
+ * returns once they're all done. If any chunk throws, the first exception
+ * caught is rethrown after the rest finish.
+ */
+void parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& body);
+
+/*
+ * Maps every chunk of parallelFor() to a partial result with
+ * map(chunkBegin, chunkEnd), then folds them into total with
+ * combine(total, partial). The chunks only depend on grainSize, and the
+ * partials are folded in index order on the calling thread, so the result
+ * is the same however many threads there are, even for floating point sums.
+ */
+template <typename T, typename Map, typename Combine>
+T parallelReduce(const int begin, const int end, const int grainSize, T total, const Map& map,
+    const Combine& combine) {
+    if (end <= begin) {
+        return total;
+    }
+    const int chunkSize = std::max(grainSize, 1);
+    std::vector<T> partials(((end - begin) + chunkSize - 1) / chunkSize);
+    parallelFor(begin, end, chunkSize, [&](const int chunkBegin, const int chunkEnd) {
+        partials[(chunkBegin - begin) / chunkSize] = map(chunkBegin, chunkEnd);
+    });
+    for (T& partial : partials) {
+        combine(total, partial);
+    }
+
+    return total;
+}
+
+/*
+ * Stages of work and what each one has to wait for. dependents[i] are the
+ * tasks waiting on task i, and numDependencies[i] how many task i waits on.
+ */
+struct TaskGraph {
+    std::vector<std::function<void()>> tasks;
+    std::vector<std::vector<int>> dependents;
+    std::vector<int> numDependencies;
+};
+
+/*
+ * Adds a task that runs once all of its dependencies are done, and returns
+ * its index for later tasks to depend on. Tasks can only depend on tasks
+ * added before them, so a graph can't have cycles.
+ */
+int addTask(TaskGraph& graph, std::function<void()> task,
+    const std::vector<int>& dependencies = {});
+
+/*
+ * Runs every task of the graph, each as soon as its dependencies are done,
+ * and returns once they all are. Tasks can use parallelFor() themselves. If
+ * a task throws, tasks that haven't started yet are skipped, and the first
+ * exception caught is rethrown at the end.
+ */
+void runTaskGraph(const TaskGraph& graph);
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <madoc/biome_generator.h>
+#include <madoc/cell_attributes.h>
+#include <madoc/vertex_format.h>
+#include <madoc/world_generator.h>
+#include <madoc/world_queries.h>
+
+
+// Dirty ranges closer together than this many cells (or vertices) are merged
+// into one upload, since resending a few unchanged bytes costs less than
+// another glBufferSubData call
+constexpr int MAX_DIRTY_CELL_GAP = 16;
+constexpr int MAX_DIRTY_VERTEX_GAP = 16;
+
+enum BrushMode {
+    RAISE_BRUSH,
+    LOWER_BRUSH,
+    PAINT_BRUSH
+};
+
+/*
+ * A circular brush. radius is in world units, and strength is how much
+ * elevation a raising or lowering brush adds or takes away per second at its
+ * middle, falling off to nothing at its edge. A painting brush sets every
+ * cell under it to biome.
+ */
+struct Brush {
+    BrushMode mode;
+    float radius;
+    float strength;
+    u_int8_t biome;
+};
+
+/*
+ * A run of count consecutive cells or vertices, starting at first
+ */
+struct IndexRange {
+    int first, count;
+};
+
+/*
+ * The vertices of every cell in a world mesh, across all levels of detail, in
+ * compressed sparse row form like CellGraph. Cell i's vertices are
+ * vertices[offsets[i]] up to vertices[offsets[i + 1]], in increasing order.
+ */
+struct CellVertexMap {
+    std::vector<int> offsets;
+    std::vector<int> vertices;
+};
+
+/*
+ * The cells edited since the GPU was last updated, each listed once
+ */
+struct DirtyCells {
+    std::vector<int> cells;
+    std::vector<bool> isDirty;
+};
+
+/*
+ * Finds the vertices of every cell in the mesh, which the vertex formats that
+ * bake in colors need to recolor a cell
+ */
+CellVertexMap createCellVertexMap(const WorldMesh& mesh, int numCells);
+
+DirtyCells createDirtyCells(int numCells);
+
+/*
+ * Applies the brush for deltaTime seconds to every cell whose centroid is
+ * within its radius of position (in world space), found by walking the cell
+ * graph out from the cell under it. Only those cells have their biomes looked
+ * up again, against the climate they already have, and whether they're land,
+ * and only the ones whose biome or land changed are marked dirty. Cells keep
+ * the hillshade and the province they were generated with.
+ */
+void applyBrush(World& world, const BiomeTable& biomeTable, const Brush& brush,
+    glm::vec2 position, float deltaTime, DirtyCells& dirtyCells);
+
+/*
+ * Sorts a list of indices and merges them into ranges, joining any two that
+ * are at most maxGap indices apart
+ */
+std::vector<IndexRange> coalesceIndices(std::vector<int> indices, int maxGap);
+
+/*
+ * Uploads the colors of the dirty cells in as few ranges as possible, then
+ * clears them. The attribute buffer is always updated; for formats that bake
+ * colors into the vertices, the mesh's colors are rewritten and the changed
+ * vertex ranges of the VBO are updated too. The dirty cells' border segments
+ * are retagged, so the coast follows cells that crossed sea level, and the
+ * slots that moved are updated in borderVBO. Throws if a range can't be
+ * uploaded.
+ */
+void uploadDirtyCells(World& world, const BiomeTable& biomeTable,
+    const CellVertexMap& cellVertices, const CellAttributeBuffer& attributeBuffer,
+    VertexFormat format, GLuint VBO, GLuint borderVBO, DirtyCells& dirtyCells);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <madoc/shader_utils.h>
+
+
+/*
+ * The different layouts the world mesh can be uploaded to the GPU in.
+ * FLOAT_VERTEX is 6 floats per vertex (xyz position, rgb color) for 24 bytes,
+ * while COMPACT_VERTEX packs a fixed-point 2D position and an RGBA8 color
+ * into 8 bytes. CELL_ID_VERTEX is also 8 bytes, but swaps the color for the
+ * ID of the vertex's voronoi cell; its color is looked up from a per-cell
+ * attribute buffer in the shader, so recoloring never touches the vertices.
+ */
+enum VertexFormat {
+    FLOAT_VERTEX,
+    COMPACT_VERTEX,
+    CELL_ID_VERTEX
+};
+
+/*
+ * A single vertex in the compact format. x and y are fixed-point offsets from
+ * the origin of the chunk the vertex belongs to, with COMPACT_POSITION_SCALE
+ * steps per grid unit. The color is normalized by OpenGL when it's read.
+ */
+struct CompactVertex {
+    int16_t x, y;
+    u_int8_t r, g, b, a;
+};
+
+/*
+ * A single vertex in the cell ID format. x and y work the same way as they do
+ * in CompactVertex.
+ */
+struct CellVertex {
+    int16_t x, y;
+    u_int32_t cellID;
+};
+
+// 8 steps per grid unit gives 1/8th of a grid unit of precision and a range
+// of +-4096 grid units around the chunk origin
+constexpr float COMPACT_POSITION_SCALE = 8.0f;
+
+/*
+ * Converts interleaved float vertices (xyz position followed by rgb color) into
+ * compact vertices relative to the given chunk origin. Throws if a vertex is
+ * too far from the origin to be represented.
+ */
+std::vector<CompactVertex> packCompactVertices(const std::vector<float>& vertices,
+    glm::vec2 origin);
+
+/*
+ * Converts interleaved float vertices into cell ID vertices relative to the
+ * given chunk origin. cellIDs holds the voronoi cell of each vertex. The float
+ * colors are dropped. Throws if a vertex is too far from the origin to be
+ * represented.
+ */
+std::vector<CellVertex> packCellVertices(const std::vector<float>& vertices,
+    const std::vector<u_int32_t>& cellIDs, glm::vec2 origin);
+
+/*
+ * Returns the size in bytes of a single vertex in the given format
+ */
+GLsizei getVertexStride(VertexFormat format);
+
+/*
+ * Sets up the vertex attribute pointers for the given format. The VAO and VBO
+ * to use must already be bound.
+ */
+void setVertexAttributes(VertexFormat format);
+
+/*
+ * Sets the uniforms the vertex shader needs to decode positions in the given
+ * format. The shader program must already be in use.
+ */
+void setVertexFormatUniforms(const ShaderUniforms& uniforms, VertexFormat format,
+    glm::vec2 origin);
@@ -1,7 +1,13 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 
+#include <glm/glm.hpp>
+
+
+// Most feature points a grid can have, since voronoiIDs are 16 bits
+constexpr int MAX_FEATURE_POINTS = 65535;
 
 /*
  * Represents a feature point on a 2D plane with an x and y coordinate,
@@ -19,6 +25,17 @@ struct MacroCell {
     std::vector<FeaturePoint> featurePoints;
 };
 
+/*
+ * Area (count), moment sums and bounds of the grid cells in a voronoi cell,
+ * gathered while the grid is labeled. Dividing the sums by count gives the
+ * voronoi cell's centroid. The bounds are inclusive grid coordinates.
+ */
+struct VoronoiCellStats {
+    int count;
+    int64_t sumX, sumY;
+    int minX, minY, maxX, maxY;
+};
+
 /*
  * All the data necessary to create a grid of cells which are then used to
  * create voronoi cells. Note that the vector 'cells' is 1D and stores
@@ -26,15 +43,20 @@ struct MacroCell {
  *
  * The fields macroWidth and macroHeight refer to the width and height of each
  * 'macro cell' in the grid. Macro cells are just larger areas on the grid made
- * up of individual cells.
+ * up of individual cells. searchRadius is how many macro cells away the
+ * closest feature point of a grid cell can be, and coverageDistance (if it's
+ * above 0) is how many grid cells away it can be. cellStats is indexed by voronoiID.
  */
 struct VoronoiGrid {
     int width, height;
     std::vector<u_int16_t> cells;
     int macroWidth, macroHeight;
+    int searchRadius;
+    int coverageDistance;
     std::vector<MacroCell> macroCells;
     int numFeaturePoints;
     std::vector<FeaturePoint*> featurePointPointers;
+    std::vector<VoronoiCellStats> cellStats;
 };
 
 /*
@@ -48,7 +70,8 @@ struct VoronoiBitmask {
 
 /*
  * Instantiates a "blank" VoronoiGrid by assigning its width, height,
- * macroWidth, and macroHeight.
+ * macroWidth, and macroHeight. Throws unless the grid is a whole number of
+ * macro cells across and down, since cells are only labeled within them.
  */
 VoronoiGrid createVoronoiGrid(int width, int height, int macroWidth, int macroHeight);
 
@@ -56,15 +79,50 @@ VoronoiGrid createVoronoiGrid(int width, int height, int macroWidth, int macroHe
  * Takes a reference to an already existing VoronoiGrid to actually create
  * voronoi cells pseudorandomly using a given seed. minFeaturePoints and
  * maxFeaturePoints refer to the min and max per macro cell, not the whole grid.
+ * Each macro cell draws its points from its own generator, so the macro cells
+ * are filled in parallel. Throws if the range is empty, if more points are
+ * asked for than a macro cell has grid cells to put them on, or if the grid
+ * ends up with more than MAX_FEATURE_POINTS.
  */
 void generateVoronoiCells(VoronoiGrid& inputGrid, int seed, int minFeaturePoints,
     int maxFeaturePoints);
 
+/*
+ * Alternative to generateVoronoiCells() that spreads feature points out
+ * evenly with Bridson's Poisson disk sampling, so that no two points are
+ * closer than minDistance. That avoids the slivers and clumps of purely random
+ * points. Macro cells hold however many points land in them, and the labeling
+ * search radius is set from how far apart the points can be. Throws if that's
+ * more than MAX_FEATURE_POINTS.
+ */
+void generatePoissonDiskCells(VoronoiGrid& inputGrid, int seed, float minDistance);
+
+/*
+ * Moves each feature point to the centroid of its voronoi cell (Lloyd
+ * relaxation) to make the cells more even, then re-labels the grid. Points
+ * never leave their macro cell, so only the macro cells around points that
+ * actually moved have to be re-labeled. Stops early once no points move.
+ */
+void relaxVoronoiCells(VoronoiGrid& inputGrid, int iterations);
+
+/*
+ * Returns the exact area-weighted centroid of a voronoi cell from its stats,
+ * in the corner coordinates (y pointing down) that traceCellCorners() uses
+ */
+glm::vec2 getCellCentroid(const VoronoiGrid& inputGrid, u_int16_t voronoiID);
+
 /*
  * based on a given grid and ID, return a bitmask of only that specific voronoi cell
  */
 VoronoiBitmask generateVoronoiBitmask(const VoronoiGrid& inputGrid, u_int16_t voronoiID);
 
+/*
+ * Same as generateVoronoiBitmask(), but writes into an existing bitmask and
+ * reuses its memory, so one bitmask can be refilled for cell after cell
+ */
+void fillVoronoiBitmask(const VoronoiGrid& inputGrid, u_int16_t voronoiID,
+    VoronoiBitmask& bitmask);
+
 /*
  * Prints out the given voronoi grid into the terminal.
  */
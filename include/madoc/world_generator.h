@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/biome_generator.h>
+#include <madoc/borders.h>
+#include <madoc/cell_graph.h>
+#include <madoc/climate.h>
+#include <madoc/delaunay.h>
+#include <madoc/hydrology.h>
+#include <madoc/regions.h>
+#include <madoc/voronoi.h>
+#include <madoc/world_mesh.h>
+#include <madoc/world_queries.h>
+
+
+/*
+ * Everything that shapes a world besides its seed. Sizes are in grid units.
+ * The world (and, for previews, the world divided by previewScale) has to be
+ * a whole number of macro cells across and down.
+ */
+struct WorldSettings {
+    int width, height;
+    int macroWidth, macroHeight;
+    int minPoints, maxPoints;
+    bool usePoissonDisk;
+    float poissonDistance;
+    int relaxIterations;
+    bool useVectorCells;
+    bool useHillshading;
+    bool isMeshOnly;
+    std::vector<float> lodTolerances;
+    int chunkWidth, chunkHeight;
+    int meshBatchSize, meshGrainSize;
+    int numProvinces, numNations;
+    float riverMinFlow;
+    int previewScale;
+    float previewPoissonDistance;
+};
+
+/*
+ * A generated world, from its cells up to the meshes that draw it. The grid
+ * and the world mesh are in grid units, and meshScale is how many world
+ * units one of those covers: 1 for a full world, or previewScale for a
+ * preview. Everything else (centroids, rivers, borders) is in world space.
+ * With hillshading, cellGradients and cellShades are filled in and every
+ * cell's color is its biome's times its shade; without it they're empty.
+ * With isMeshOnly, only the cells, their climate and biomes and the mesh are
+ * generated, and the tables, rivers, regions and borders are left empty.
+ */
+struct World {
+    int seed;
+    float meshScale;
+    VoronoiGrid grid;
+    DelaunayTriangulation triangulation;
+    std::vector<std::vector<int>> cellNeighbors;
+    CellGraph cellGraph;
+    std::vector<glm::vec2> cellCentroids;
+    std::vector<float> cellElevations;
+    std::vector<glm::vec2> cellGradients;
+    std::vector<float> cellShades;
+    Climate climate;
+    std::vector<u_int8_t> cellBiomes;
+    std::vector<u_int8_t> cellColors;
+    SummedAreaTables tables;
+    WorldMesh mesh;
+    float originalACMR, originalATVR, optimizedACMR, optimizedATVR;
+    Hydrology hydrology;
+    std::vector<float> riverVertices;
+    std::vector<float> cellAreas;
+    std::vector<bool> isLandCell;
+    RegionMap provinces, nations;
+    std::vector<BorderSegment> borderSegments;
+    BorderMesh borderMesh;
+};
+
+/*
+ * Runs the whole generation pipeline for a seed as a task graph on the task
+ * scheduler, so stages that don't need each other run side by side. Safe to
+ * call from a background thread, since it never touches OpenGL.
+ */
+World generateWorld(const WorldSettings& settings, const BiomeTable& biomeTable, int seed);
+
+/*
+ * Quickly generates a coarse stand-in for generateWorld() with the same seed:
+ * a grid previewScale times smaller each way, with Poisson disk cells
+ * previewPoissonDistance (preview) grid units apart, colored by their biomes
+ * and nothing more (no rivers, regions or borders). Elevation comes from the
+ * same noise sampled at each coarse cell's centroid in world space, so the
+ * continents are where the full world will put them.
+ */
+World generatePreviewWorld(const WorldSettings& settings, const BiomeTable& biomeTable,
+    int seed);
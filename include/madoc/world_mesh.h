@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <madoc/shader_utils.h>
+#include <madoc/vertex_format.h>
+#include <madoc/voronoi.h>
+
+
+// Chunks are grouped into square pages of this many grid units, and every chunk
+// in a page shares the page's center as its vertex origin. That keeps compact
+// vertices within their +-4096 unit range, and lets a whole page of chunks be
+// drawn with one multi-draw call.
+constexpr int ORIGIN_PAGE_SIZE = 8000;
+
+// The coarsest level of detail samples each chunk as this many quads across,
+// so its cost doesn't depend on how many cells are in the chunk
+constexpr int RASTER_LOD_RESOLUTION = 8;
+
+// A level of detail is used while its error is at most this many pixels on
+// screen, give or take the hysteresis so levels don't flicker back and forth
+constexpr float LOD_MAX_PIXEL_ERROR = 1.0f;
+constexpr float LOD_HYSTERESIS = 0.25f;
+
+/*
+ * Where a single level of detail of a chunk is stored. Indices are local to
+ * the chunk and get baseVertex added when drawn.
+ */
+struct ChunkLod {
+    int firstIndex, numIndices;
+    int baseVertex, numVertices;
+};
+
+/*
+ * A rectangular piece of the world mesh. Cells belong to the chunk that their
+ * feature point falls in, so the bounds (in world space) can stick out a bit
+ * past the chunk's spot on the grid. lods[0] is the most detailed mesh.
+ */
+struct MeshChunk {
+    glm::vec2 boundsMin, boundsMax;
+    glm::vec2 origin;
+    std::vector<ChunkLod> lods;
+};
+
+/*
+ * The whole world's mesh, stored level by level and chunk by chunk in single
+ * vertex and index lists. vertices has 6 floats per vertex (xyz position, rgb
+ * color) and vertexCellIDs has the voronoiID of each vertex. lodErrors is how
+ * far (in grid units) each level can be from the real cell outlines. The
+ * staging lists are only used while cells are being added.
+ */
+struct WorldMesh {
+    int chunkWidth, chunkHeight;
+    int numChunksX, numChunksY;
+    int numLods;
+    std::vector<float> lodErrors;
+    std::vector<float> vertices;
+    std::vector<u_int32_t> vertexCellIDs;
+    std::vector<unsigned int> indices;
+    std::vector<MeshChunk> chunks;
+
+    std::vector<std::vector<float>> stagingVertices;
+    std::vector<std::vector<u_int32_t>> stagingCellIDs;
+    std::vector<std::vector<unsigned int>> stagingIndices;
+};
+
+/*
+ * Instantiates an empty WorldMesh split into chunks of the given size. There's
+ * one level of detail per outline tolerance, plus a final raster level.
+ */
+WorldMesh createWorldMesh(int worldWidth, int worldHeight, int chunkWidth, int chunkHeight,
+    const std::vector<float>& lodTolerances);
+
+/*
+ * Returns the index of the chunk that the given grid coordinates are in
+ */
+int getChunkIndex(const WorldMesh& mesh, int x, int y);
+
+/*
+ * Adds a single cell's polygon to one level of detail of a chunk. vertices has
+ * x, y, z for each vertex like getEdgeVertices() returns, and indices start
+ * from 0 for the cell's first vertex.
+ */
+void addCellToMesh(WorldMesh& mesh, int lod, int chunkIndex, u_int32_t cellID,
+    const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+    const std::vector<float>& color);
+
+/*
+ * Fills in the coarsest level of detail, which samples the grid's cells on a
+ * RASTER_LOD_RESOLUTION x RASTER_LOD_RESOLUTION grid of quads per chunk.
+ * cellColors holds the packed RGBA8 color of every cell.
+ */
+void addRasterLodToMesh(WorldMesh& mesh, const VoronoiGrid& inputGrid,
+    const std::vector<u_int8_t>& cellColors);
+
+/*
+ * Lays every chunk out in the final vertex and index lists, and figures out
+ * their bounds and origins. Call once after all cells have been added.
+ */
+void finishWorldMesh(WorldMesh& mesh);
+
+/*
+ * Reorders each chunk's triangles and vertices for the GPU's vertex cache
+ */
+void optimizeWorldMesh(WorldMesh& mesh);
+
+/*
+ * Returns the index list of one level of detail with every chunk's baseVertex
+ * applied, as if the whole world were drawn in a single draw call.
+ */
+std::vector<unsigned int> getGlobalIndices(const WorldMesh& mesh, int lod);
+
+/*
+ * Packs the mesh into the given vertex format and uploads it into the VBO and
+ * EBO. The VAO to use must already be bound. Throws if the mesh can't be packed.
+ */
+void uploadWorldMesh(const WorldMesh& mesh, VertexFormat format, GLuint VBO, GLuint EBO);
+
+/*
+ * Re-uploads numVertices of the mesh's vertices starting at firstVertex into
+ * the VBO, packed into the given format. Only that range of the buffer is
+ * touched. Throws if the range is out of bounds or can't be packed.
+ */
+void updateWorldMeshVertices(const WorldMesh& mesh, VertexFormat format, GLuint VBO,
+    int firstVertex, int numVertices);
+
+/*
+ * Picks the coarsest level of detail whose error is still under a pixel at the
+ * given zoom (in screen pixels per grid unit). Starting from the current level
+ * and applying some hysteresis keeps the level from popping back and forth.
+ */
+int selectLod(const WorldMesh& mesh, int currentLod, float pixelsPerUnit);
+
+/*
+ * Returns the zoom (in screen pixels per grid unit) below which selectLod()
+ * switches from the level before the given one to it
+ */
+float getLodSwitchZoom(const WorldMesh& mesh, int lod);
+
+/*
+ * Returns the indices of every chunk whose bounds overlap the given world
+ * space rectangle.
+ */
+std::vector<int> getVisibleChunks(const WorldMesh& mesh, glm::vec2 boundsMin,
+    glm::vec2 boundsMax);
+
+/*
+ * Draws one level of detail of the given chunks. Chunks that share an origin
+ * are drawn together with a single glMultiDrawElementsBaseVertex call.
+ */
+void drawWorldMesh(const WorldMesh& mesh, const std::vector<int>& visibleChunks, int lod,
+    VertexFormat format, const ShaderUniforms& uniforms);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <madoc/voronoi.h>
+
+
+/*
+ * Summed-area tables over the grid of a world: each entry is the total of
+ * everything above and to the left of it, so the total over any rectangle is
+ * four lookups. Every table is (width + 1) x (height + 1), row-major, with a
+ * row and column of zeroes in front. elevationSums adds up each grid cell's
+ * elevation, landCounts counts grid cells at or above sea level, and
+ * biomeCounts holds one table per biome (biome-major) counting the grid cells
+ * of that biome. meshScale is the world's (see World).
+ */
+struct SummedAreaTables {
+    int width, height;
+    float meshScale;
+    std::vector<double> elevationSums;
+    std::vector<u_int32_t> landCounts;
+    int numBiomes;
+    std::vector<u_int32_t> biomeCounts;
+};
+
+/*
+ * A rectangle of grid cells from (minX, minY) up to but not including
+ * (maxX, maxY)
+ */
+struct GridRect {
+    int minX, minY;
+    int maxX, maxY;
+};
+
+/*
+ * Returns the voronoiID of the cell at a world space position straight from
+ * the grid's labels, or -1 if the position is off the world. meshScale is the
+ * world's (see World). Any per-cell value of the world can be looked up with it.
+ */
+int getCellAtPosition(const VoronoiGrid& inputGrid, float meshScale, glm::vec2 position);
+
+/*
+ * Builds the tables for a world in parallel, giving every grid cell the
+ * elevation and biome of the voronoi cell it's labeled with. Cells at or above
+ * seaLevel count as land.
+ */
+SummedAreaTables createSummedAreaTables(const VoronoiGrid& inputGrid, float meshScale,
+    const std::vector<float>& cellElevations, const std::vector<u_int8_t>& cellBiomes,
+    int numBiomes, float seaLevel);
+
+/*
+ * Returns every grid cell that the world space rectangle touches, clipped to
+ * the world. The rectangle can end up empty.
+ */
+GridRect getGridRect(const SummedAreaTables& tables, glm::vec2 boundsMin, glm::vec2 boundsMax);
+
+int getRectArea(const GridRect& rect);
+
+/*
+ * Mean elevation of the grid cells in the rectangle, or 0 if it's empty
+ */
+float getMeanElevation(const SummedAreaTables& tables, const GridRect& rect);
+
+/*
+ * Fraction of the grid cells in the rectangle that are land, or 0 if it's empty
+ */
+float getLandFraction(const SummedAreaTables& tables, const GridRect& rect);
+
+/*
+ * Number of grid cells of the given biome in the rectangle
+ */
+int getBiomeCount(const SummedAreaTables& tables, const GridRect& rect, int biome);
+
+/*
+ * Number of grid cells of each biome in the rectangle
+ */
+std::vector<int> getBiomeHistogram(const SummedAreaTables& tables, const GridRect& rect);
@@ -1,73 +1,286 @@
-#include <random>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 
 #include <madoc/biome_generator.h>
+#include <madoc/cell_attributes.h>
 #include <madoc/perlin_noise.h>
+#include <madoc/task_scheduler.h>
 
 
-std::vector<float> generateBiomeColor(float x, float y, int seed) {
-    std::array<glm::vec2, 32> gradientVectors = generateGradients();
-    std::array<int, 512> elevationPermutationTable = generatePermutationTable(seed);
+// Cells are classified and their noise sampled in parallel in chunks of this many
+constexpr int CELL_GRAIN_SIZE = 2048;
+
+// Builds one axis of the lookup table from the thresholds along it
+static BiomeAxis createBiomeAxis(std::vector<float> thresholds) {
+    // Only thresholds strictly inside the axis split it, since values are
+    // clamped to it
+    std::sort(thresholds.begin(), thresholds.end());
+    thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+    thresholds.erase(std::remove_if(thresholds.begin(), thresholds.end(),
+        [](const float threshold) {
+            return threshold <= 0.0f || threshold >= 1.0f;
+        }), thresholds.end());
 
-    std::mt19937 generator(seed);
-    int precipSeed = generator();
-    std::array<int, 512> precipPermutationTable = generatePermutationTable(precipSeed);
+    BiomeAxis axis;
+    axis.thresholds = thresholds;
+    axis.numIntervals = static_cast<int>(thresholds.size()) + 1;
+    axis.baseInterval.resize(BIOME_AXIS_RESOLUTION);
+    axis.splitValue.resize(BIOME_AXIS_RESOLUTION);
+
+    // The resolution is a power of two, so a step's bounds are exact floats
+    // and a value always lands in the step it's actually in
+    int interval = 0;
+    for (int i = 0; i < BIOME_AXIS_RESOLUTION; i++) {
+        const float stepMin = static_cast<float>(i) / BIOME_AXIS_RESOLUTION;
+        const float stepMax = static_cast<float>(i + 1) / BIOME_AXIS_RESOLUTION;
+        while (interval < thresholds.size() && thresholds[interval] < stepMin) {
+            interval++;
+        }
+        axis.baseInterval[i] = interval;
+        axis.splitValue[i] = 2.0f;
+        if (interval < thresholds.size() && thresholds[interval] < stepMax) {
+            if (interval + 1 < thresholds.size() && thresholds[interval + 1] < stepMax) {
+                throw std::runtime_error("Biome thresholds " +
+                    std::to_string(thresholds[interval]) + " and " +
+                    std::to_string(thresholds[interval + 1]) + " are too close together");
+            }
+            axis.splitValue[i] = thresholds[interval];
+        }
+    }
 
-    float worldHeight = 600;
-    float temperature = generateTemperature(y, worldHeight, 1.0f);
-    float elevation = generateElevation(elevationPermutationTable, gradientVectors, x, y);
-    float precipitation = generatePrecipitation(precipPermutationTable, gradientVectors, x, y);
+    return axis;
+}
 
-    // Impassible mountain
-    if (elevation >= 0.67) {
-        return {0.392f, 0.392f, 0.392f};
+// Returns the terrain named in the biome file, or throws
+static BiomeTerrain parseBiomeTerrain(const std::string& name, const std::string& filePath) {
+    if (name == "sea") {
+        return SEA_TERRAIN;
     }
-    // Mountain
-    if (elevation >= 0.62f) {
-        return {0.588f, 0.588f, 0.588f};
+    if (name == "land") {
+        return LAND_TERRAIN;
+    }
+    if (name == "mountain") {
+        return MOUNTAIN_TERRAIN;
+    }
+    if (name == "impassable") {
+        return IMPASSABLE_TERRAIN;
+    }
+    throw std::runtime_error("Unknown terrain " + name + " in biome file: " + filePath);
+}
+
+// Returns the interval along the axis that a value falls in
+static int getAxisInterval(const BiomeAxis& axis, const float value) {
+    const float clamped = std::clamp(value, 0.0f, 1.0f);
+    const int step = std::min(static_cast<int>(clamped * BIOME_AXIS_RESOLUTION),
+        BIOME_AXIS_RESOLUTION - 1);
+    return axis.baseInterval[step] + static_cast<int>(clamped >= axis.splitValue[step]);
+}
+
+BiomeTable loadBiomeTable(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open biome file: " + filePath);
     }
-    // Lower land
-    if (elevation >= 0.50f) {
-        // Arctic
-        if (temperature <= 0.10f) {
-            return {0.921f, 0.921f, 0.921f};
+
+    BiomeTable biomeTable;
+    std::vector<float> elevationThresholds, temperatureThresholds, precipitationThresholds;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        // Skip comments and blank lines
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
         }
-        // Tundra
-        if (temperature <= 0.33f) {
-            return {0.0f, 0.392f, 0.0f};
+
+        Biome biome;
+        std::string terrain;
+        float r, g, b;
+        std::istringstream lineStream(line);
+        if (!(lineStream >> biome.name >> terrain >> biome.minElevation >> biome.maxElevation
+            >> biome.minTemperature >> biome.maxTemperature >> biome.minPrecipitation
+            >> biome.maxPrecipitation >> r >> g >> b)) {
+            throw std::runtime_error("Failed to parse line " + std::to_string(lineNumber) +
+                " of biome file: " + filePath);
         }
-        // Forest
-        if (temperature <= 0.66f) {
-            return {0.0f, 0.588f, 0.0f};
+        biome.terrain = parseBiomeTerrain(terrain, filePath);
+        biome.color = {r / 255.0f, g / 255.0f, b / 255.0f};
+        biomeTable.biomes.push_back(biome);
+
+        elevationThresholds.insert(elevationThresholds.end(),
+            {biome.minElevation, biome.maxElevation});
+        temperatureThresholds.insert(temperatureThresholds.end(),
+            {biome.minTemperature, biome.maxTemperature});
+        precipitationThresholds.insert(precipitationThresholds.end(),
+            {biome.minPrecipitation, biome.maxPrecipitation});
+    }
+    // One ID is kept free to mark table entries without a biome
+    if (biomeTable.biomes.empty() || biomeTable.biomes.size() > 255) {
+        throw std::runtime_error("Biome file must have between 1 and 255 biomes: " + filePath);
+    }
+
+    // Each terrain starts at the lowest of its biomes and the ones above it,
+    // and everything below that has to be a lower terrain
+    float terrainLevels[NUM_BIOME_TERRAINS + 1];
+    std::fill_n(terrainLevels, NUM_BIOME_TERRAINS + 1, std::numeric_limits<float>::infinity());
+    for (const Biome& biome : biomeTable.biomes) {
+        for (int terrain = 0; terrain <= biome.terrain; terrain++) {
+            terrainLevels[terrain] = std::min(terrainLevels[terrain], biome.minElevation);
         }
-        // Savannah
-        if (temperature <= 0.85f) {
-            return {0.784f, 0.725f, 0.0f};
+    }
+    for (const Biome& biome : biomeTable.biomes) {
+        if (biome.maxElevation > terrainLevels[biome.terrain + 1]) {
+            throw std::runtime_error("Biome " + biome.name +
+                " reaches above where a higher terrain starts in " + filePath);
         }
-        // Hot
-        else {
-            // Rainforest
-            if (precipitation >= 0.55f) {
-                return {0.0f, 0.784f, 0.0f};
-            }
-            // Desert
-            else {
-                return {1.0f, 0.784f, 0.0f};
+    }
+    biomeTable.seaLevel = terrainLevels[LAND_TERRAIN];
+    biomeTable.mountainLevel = terrainLevels[MOUNTAIN_TERRAIN];
+    biomeTable.impassableLevel = terrainLevels[IMPASSABLE_TERRAIN];
+
+    biomeTable.elevationAxis = createBiomeAxis(elevationThresholds);
+    biomeTable.temperatureAxis = createBiomeAxis(temperatureThresholds);
+    biomeTable.precipitationAxis = createBiomeAxis(precipitationThresholds);
+    const int numElevations = biomeTable.elevationAxis.numIntervals;
+    const int numTemperatures = biomeTable.temperatureAxis.numIntervals;
+    const int numPrecipitations = biomeTable.precipitationAxis.numIntervals;
+
+    // Every entry of the table gets the first biome containing its intervals.
+    // The lowest value of an interval is in it, so it stands in for the rest.
+    auto getIntervalMin = [](const BiomeAxis& axis, const int interval) {
+        return interval == 0 ? 0.0f : axis.thresholds[interval - 1];
+    };
+    biomeTable.biomeIDs.resize(numElevations * numTemperatures * numPrecipitations);
+    for (int e = 0; e < numElevations; e++) {
+        const float elevation = getIntervalMin(biomeTable.elevationAxis, e);
+        for (int t = 0; t < numTemperatures; t++) {
+            const float temperature = getIntervalMin(biomeTable.temperatureAxis, t);
+            for (int p = 0; p < numPrecipitations; p++) {
+                const float precipitation = getIntervalMin(biomeTable.precipitationAxis, p);
+
+                u_int8_t biomeID = 255;
+                for (int i = 0; i < biomeTable.biomes.size(); i++) {
+                    const Biome& biome = biomeTable.biomes[i];
+                    const bool isInside =
+                        elevation >= biome.minElevation && elevation < biome.maxElevation &&
+                        temperature >= biome.minTemperature &&
+                        temperature < biome.maxTemperature &&
+                        precipitation >= biome.minPrecipitation &&
+                        precipitation < biome.maxPrecipitation;
+                    if (isInside) {
+                        biomeID = static_cast<u_int8_t>(i);
+                        break;
+                    }
+                }
+                if (biomeID == 255) {
+                    throw std::runtime_error("No biome covers elevation " +
+                        std::to_string(elevation) + ", temperature " + std::to_string(temperature) +
+                        ", precipitation " + std::to_string(precipitation) + " in " + filePath);
+                }
+                biomeTable.biomeIDs[(((e * numTemperatures) + t) * numPrecipitations) + p] =
+                    biomeID;
             }
         }
     }
-    // Shallow Sea
-    if (elevation >= 0.45f) {
-        return {0.392f, 0.588f, 0.784f};
+
+    for (const Biome& biome : biomeTable.biomes) {
+        packCellColor(biomeTable.packedColors,
+            static_cast<int>(biomeTable.packedColors.size() / 4), biome.color);
     }
-    // Sea
-    if (elevation >= 0.40f) {
-        return {0.392f, 0.392f, 0.784f};
+
+    return biomeTable;
+}
+
+u_int8_t classifyBiome(const BiomeTable& biomeTable, const float elevation,
+    const float temperature, const float precipitation) {
+    const int e = getAxisInterval(biomeTable.elevationAxis, elevation);
+    const int t = getAxisInterval(biomeTable.temperatureAxis, temperature);
+    const int p = getAxisInterval(biomeTable.precipitationAxis, precipitation);
+    return biomeTable.biomeIDs[(((e * biomeTable.temperatureAxis.numIntervals) + t) *
+        biomeTable.precipitationAxis.numIntervals) + p];
+}
+
+void classifyBiomes(const BiomeTable& biomeTable, const std::vector<float>& elevation,
+    const std::vector<float>& temperature, const std::vector<float>& precipitation,
+    std::vector<u_int8_t>& cellBiomes) {
+    const int numCells = static_cast<int>(elevation.size());
+    cellBiomes.resize(numCells);
+
+    parallelFor(0, numCells, CELL_GRAIN_SIZE, [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++) {
+            cellBiomes[i] = classifyBiome(biomeTable, elevation[i], temperature[i],
+                precipitation[i]);
+        }
+    });
+}
+
+void packBiomeColors(const BiomeTable& biomeTable, const std::vector<u_int8_t>& cellBiomes,
+    std::vector<u_int8_t>& cellColors) {
+    cellColors.resize(cellBiomes.size() * 4);
+    for (int i = 0; i < cellBiomes.size(); i++) {
+        std::copy_n(&biomeTable.packedColors[cellBiomes[i] * 4], 4, &cellColors[i * 4]);
     }
-    // Deep Sea
-    else {
-        return {0.196f, 0.196f, 0.784f};
+}
+
+std::vector<float> generateCellElevations(const std::vector<glm::vec2>& positions, int seed) {
+    std::array<int, 512> elevationPermutationTable = generatePermutationTable(seed);
+
+    std::vector<float> elevations(positions.size());
+    parallelFor(0, static_cast<int>(positions.size()), CELL_GRAIN_SIZE,
+        [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                elevations[i] = generateElevation(elevationPermutationTable, positions[i].x,
+                    positions[i].y);
+            }
+        });
+
+    return elevations;
+}
+
+std::vector<float> generateCellElevations(const std::vector<glm::vec2>& positions, int seed,
+    std::vector<glm::vec2>& gradients) {
+    std::array<int, 512> elevationPermutationTable = generatePermutationTable(seed);
+
+    std::vector<float> elevations(positions.size());
+    gradients.resize(positions.size());
+    parallelFor(0, static_cast<int>(positions.size()), CELL_GRAIN_SIZE,
+        [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                elevations[i] = generateElevation(elevationPermutationTable, positions[i].x,
+                    positions[i].y, gradients[i]);
+            }
+        });
+
+    return elevations;
+}
+
+std::vector<float> getHillshades(const std::vector<float>& elevation,
+    const std::vector<glm::vec2>& gradients, const float seaLevel) {
+    const float flatShade = HILLSHADE_LIGHT_DIRECTION.z;
+
+    std::vector<float> shades(elevation.size(), 1.0f);
+    for (int i = 0; i < elevation.size(); i++) {
+        if (elevation[i] < seaLevel) {
+            continue;
+        }
+        const glm::vec3 normal = glm::normalize(glm::vec3(-gradients[i] * HILLSHADE_RELIEF,
+            1.0f));
+        shades[i] = std::max(glm::dot(normal, HILLSHADE_LIGHT_DIRECTION), 0.0f) / flatShade;
     }
 
+    return shades;
+}
+
+void shadeCellColor(std::vector<u_int8_t>& cellColors, const int cellID, const float shade) {
+    for (int i = 0; i < 3; i++) {
+        const float shaded = std::round(static_cast<float>(cellColors[(cellID * 4) + i]) * shade);
+        cellColors[(cellID * 4) + i] = static_cast<u_int8_t>(std::min(shaded, 255.0f));
+    }
 }
 
 float generateTemperature(float y, float worldHeight, float tempMult) {
@@ -77,16 +290,15 @@ float generateTemperature(float y, float worldHeight, float tempMult) {
     return 1 - ((distanceFromEquator * tempMult) / equatorValue);
 }
 
-float generateElevation(std::array<int, 512>& permutationTable,
-                        std::array<glm::vec2, 32>& gradientVectors, float x, float y) {
-    float perlinSample = samplePerlinOctaves(permutationTable, gradientVectors,
-                                             x, y, 4, 1.0f, 0.01f, 0.5f, 2.0f);
+float generateElevation(const std::array<int, 512>& permutationTable, float x, float y) {
+    float perlinSample = samplePerlinOctaves<ELEVATION_OCTAVES>(permutationTable, x, y);
     return (perlinSample + 1) / 2;
 }
 
-float generatePrecipitation(std::array<int, 512>& permutationTable,
-                            std::array<glm::vec2, 32>& gradientVectors, float x, float y) {
-    float perlinSample = samplePerlinOctaves(permutationTable, gradientVectors,
-                                             x, y, 4, 1.0f, 0.01f, 0.5f, 2.0f);
-    return (perlinSample + 1) / 2;
+float generateElevation(const std::array<int, 512>& permutationTable, float x, float y,
+                        glm::vec2& gradient) {
+    glm::vec3 perlinSample = samplePerlinOctavesWithDerivative<ELEVATION_OCTAVES>(
+        permutationTable, x, y);
+    gradient = glm::vec2(perlinSample.y, perlinSample.z) / 2.0f;
+    return (perlinSample.x + 1) / 2;
 }
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <madoc/borders.h>
+#include <madoc/task_scheduler.h>
+
+
+// Colors of each border type, in the order of BorderType
+constexpr std::array<glm::vec3, NUM_BORDER_TYPES> BORDER_COLORS = {{
+    {0.25f, 0.25f, 0.25f},
+    {0.45f, 0.35f, 0.20f},
+    {0.70f, 0.10f, 0.10f},
+    {0.05f, 0.05f, 0.10f}
+}};
+
+// How far (in grid units) an edge's ends may be from a neighbor's bisector
+// for the edge to count as shared with that neighbor
+constexpr double SHARED_EDGE_TOLERANCE = 1e-6;
+
+// Cells are split into chunks of this many while finding their shared edges
+constexpr int BORDER_GRAIN_SIZE = 256;
+
+// Adds the edges cell i shares with a higher voronoiID to the segments
+static void addCellBorderSegments(const VoronoiGrid& inputGrid,
+    const DelaunayTriangulation& triangulation,
+    const std::vector<std::vector<int>>& cellNeighbors, const int i,
+    std::vector<BorderSegment>& segments) {
+    const std::vector<glm::dvec2> polygon = getVoronoiPolygon(triangulation,
+        cellNeighbors[i], i, {0.0, 0.0}, {inputGrid.width, inputGrid.height});
+    const glm::dvec2 point = triangulation.points[i];
+
+    for (int j = 0; j < polygon.size(); j++) {
+        const glm::dvec2 from = polygon[j];
+        const glm::dvec2 to = polygon[(j + 1) % polygon.size()];
+        if (glm::length(to - from) < SHARED_EDGE_TOLERANCE) {
+            continue;
+        }
+
+        // Every shared edge lies on the bisector between this cell's
+        // point and the neighbor's, and edges along the world's edge lie
+        // on no bisector at all
+        int sharedNeighbor = -1;
+        double closestDistance = SHARED_EDGE_TOLERANCE;
+        for (const int neighbor : cellNeighbors[i]) {
+            const glm::dvec2 normal = glm::normalize(triangulation.points[neighbor] - point);
+            const double offset = glm::dot(normal,
+                (triangulation.points[neighbor] + point) / 2.0);
+            const double distance = std::max(std::abs(glm::dot(normal, from) - offset),
+                std::abs(glm::dot(normal, to) - offset));
+            if (distance < closestDistance) {
+                closestDistance = distance;
+                sharedNeighbor = neighbor;
+            }
+        }
+
+        // Both cells see the edge, so only the lower ID keeps it
+        if (sharedNeighbor > i) {
+            segments.push_back({i, sharedNeighbor,
+                {static_cast<float>(from.x), -static_cast<float>(from.y)},
+                {static_cast<float>(to.x), -static_cast<float>(to.y)}});
+        }
+    }
+}
+
+std::vector<BorderSegment> getVoronoiBorderSegments(const VoronoiGrid& inputGrid,
+    const DelaunayTriangulation& triangulation,
+    const std::vector<std::vector<int>>& cellNeighbors) {
+    // Each chunk of cells finds its own segments, and the chunks' segments are
+    // joined in cell order, so they come out the same as one pass would
+    return parallelReduce(0, inputGrid.numFeaturePoints, BORDER_GRAIN_SIZE,
+        std::vector<BorderSegment>(), [&](const int begin, const int end) {
+            std::vector<BorderSegment> segments;
+            for (int i = begin; i < end; i++) {
+                addCellBorderSegments(inputGrid, triangulation, cellNeighbors, i, segments);
+            }
+            return segments;
+        }, [](std::vector<BorderSegment>& total, const std::vector<BorderSegment>& segments) {
+            total.insert(total.end(), segments.begin(), segments.end());
+        });
+}
+
+std::vector<BorderSegment> getGridBorderSegments(const VoronoiGrid& inputGrid) {
+    std::vector<BorderSegment> segments;
+    const int width = inputGrid.width;
+    const int height = inputGrid.height;
+
+    // Horizontal edges, between row y - 1 and row y
+    for (int y = 1; y < height; y++) {
+        int x = 0;
+        while (x < width) {
+            const int above = inputGrid.cells[((y - 1) * width) + x];
+            const int below = inputGrid.cells[(y * width) + x];
+            if (above == below) {
+                x++;
+                continue;
+            }
+            const int start = x;
+            while (x < width && inputGrid.cells[((y - 1) * width) + x] == above &&
+                inputGrid.cells[(y * width) + x] == below) {
+                x++;
+            }
+            segments.push_back({std::min(above, below), std::max(above, below),
+                {static_cast<float>(start), static_cast<float>(-y)},
+                {static_cast<float>(x), static_cast<float>(-y)}});
+        }
+    }
+
+    // Vertical edges, between column x - 1 and column x
+    for (int x = 1; x < width; x++) {
+        int y = 0;
+        while (y < height) {
+            const int left = inputGrid.cells[(y * width) + x - 1];
+            const int right = inputGrid.cells[(y * width) + x];
+            if (left == right) {
+                y++;
+                continue;
+            }
+            const int start = y;
+            while (y < height && inputGrid.cells[(y * width) + x - 1] == left &&
+                inputGrid.cells[(y * width) + x] == right) {
+                y++;
+            }
+            segments.push_back({std::min(left, right), std::max(left, right),
+                {static_cast<float>(x), static_cast<float>(-start)},
+                {static_cast<float>(x), static_cast<float>(-y)}});
+        }
+    }
+
+    return segments;
+}
+
+static BorderType getBorderType(const BorderSegment& segment,
+    const std::vector<bool>& isLandCell, const RegionMap& provinces, const RegionMap& nations) {
+    if (isLandCell[segment.cellA] != isLandCell[segment.cellB]) {
+        return COAST_BORDER;
+    }
+
+    const int provinceA = provinces.cellRegions[segment.cellA];
+    const int provinceB = provinces.cellRegions[segment.cellB];
+    if (provinceA == provinceB) {
+        return CELL_BORDER;
+    }
+    const int nationA = provinceA == -1 ? -1 : nations.cellRegions[provinceA];
+    const int nationB = provinceB == -1 ? -1 : nations.cellRegions[provinceB];
+    return nationA != nationB ? NATION_BORDER : PROVINCE_BORDER;
+}
+
+// Writes the two vertices of the segment in a slot, in the color of its type
+static void writeSlotVertices(BorderMesh& mesh, const std::vector<BorderSegment>& segments,
+    const int slot) {
+    const int segmentIndex = mesh.slotSegments[slot];
+    const BorderSegment& segment = segments[segmentIndex];
+    const glm::vec3 color = BORDER_COLORS[mesh.segmentTypes[segmentIndex]];
+    const std::array<float, 12> vertices = {segment.from.x, segment.from.y, 0.0f,
+        color.r, color.g, color.b, segment.to.x, segment.to.y, 0.0f, color.r, color.g, color.b};
+    std::copy(vertices.begin(), vertices.end(), mesh.vertices.begin() + (slot * 12));
+}
+
+BorderMesh createBorderMesh(const std::vector<BorderSegment>& segments,
+    const std::vector<bool>& isLandCell, const RegionMap& provinces, const RegionMap& nations) {
+    const int numSegments = static_cast<int>(segments.size());
+    BorderMesh mesh;
+    mesh.segmentTypes.resize(numSegments);
+    std::array<int, NUM_BORDER_TYPES> typeCounts = {};
+    float totalLength = 0.0f;
+    for (int i = 0; i < numSegments; i++) {
+        totalLength += glm::length(segments[i].to - segments[i].from);
+        mesh.segmentTypes[i] = getBorderType(segments[i], isLandCell, provinces, nations);
+        typeCounts[mesh.segmentTypes[i]]++;
+    }
+    mesh.averageSegmentLength = segments.empty() ? 0.0f :
+        totalLength / static_cast<float>(numSegments);
+
+    // Sort the segments into their types, keeping them in order within each
+    std::array<int, NUM_BORDER_TYPES> nextSlot;
+    int firstSlot = 0;
+    for (int type = 0; type < NUM_BORDER_TYPES; type++) {
+        mesh.firstVertex[type] = firstSlot * 2;
+        mesh.numVertices[type] = typeCounts[type] * 2;
+        nextSlot[type] = firstSlot;
+        firstSlot += typeCounts[type];
+    }
+    mesh.segmentSlots.resize(numSegments);
+    mesh.slotSegments.resize(numSegments);
+    for (int i = 0; i < numSegments; i++) {
+        const int slot = nextSlot[mesh.segmentTypes[i]]++;
+        mesh.segmentSlots[i] = slot;
+        mesh.slotSegments[slot] = i;
+    }
+    mesh.vertices.resize(static_cast<size_t>(numSegments) * 12);
+    for (int slot = 0; slot < numSegments; slot++) {
+        writeSlotVertices(mesh, segments, slot);
+    }
+
+    // Which segments each cell has, by a counting sort on both of their cells
+    mesh.cellSegmentOffsets.assign(isLandCell.size() + 1, 0);
+    for (const BorderSegment& segment : segments) {
+        mesh.cellSegmentOffsets[segment.cellA + 1]++;
+        mesh.cellSegmentOffsets[segment.cellB + 1]++;
+    }
+    for (int i = 0; i < isLandCell.size(); i++) {
+        mesh.cellSegmentOffsets[i + 1] += mesh.cellSegmentOffsets[i];
+    }
+    mesh.cellSegments.resize(static_cast<size_t>(numSegments) * 2);
+    std::vector<int> nextCellSegment(mesh.cellSegmentOffsets.begin(),
+        mesh.cellSegmentOffsets.end() - 1);
+    for (int i = 0; i < numSegments; i++) {
+        mesh.cellSegments[nextCellSegment[segments[i].cellA]++] = i;
+        mesh.cellSegments[nextCellSegment[segments[i].cellB]++] = i;
+    }
+
+    return mesh;
+}
+
+// Swaps the segments in two slots, keeping track of both slots
+static void swapSlots(BorderMesh& mesh, const int slotA, const int slotB,
+    std::vector<int>& changedSlots) {
+    if (slotA == slotB) {
+        return;
+    }
+    std::swap(mesh.slotSegments[slotA], mesh.slotSegments[slotB]);
+    mesh.segmentSlots[mesh.slotSegments[slotA]] = slotA;
+    mesh.segmentSlots[mesh.slotSegments[slotB]] = slotB;
+    changedSlots.push_back(slotA);
+    changedSlots.push_back(slotB);
+}
+
+std::vector<int> retagBorderSegments(BorderMesh& mesh, const std::vector<BorderSegment>& segments,
+    const std::vector<int>& cells, const std::vector<bool>& isLandCell,
+    const RegionMap& provinces, const RegionMap& nations) {
+    std::vector<int> changedSlots;
+    for (const int cell : cells) {
+        for (int i = mesh.cellSegmentOffsets[cell]; i < mesh.cellSegmentOffsets[cell + 1]; i++) {
+            const int segment = mesh.cellSegments[i];
+            const int oldType = mesh.segmentTypes[segment];
+            const int newType = getBorderType(segments[segment], isLandCell, provinces, nations);
+            if (newType == oldType) {
+                continue;
+            }
+
+            // Step the segment one range at a time: swap it to the end of its
+            // range and hand that slot to the range after, or to the start
+            // and hand it to the range before. The segments it swaps with
+            // stay in their own ranges.
+            for (int type = oldType; type < newType; type++) {
+                const int lastSlot = ((mesh.firstVertex[type] + mesh.numVertices[type]) / 2) - 1;
+                swapSlots(mesh, mesh.segmentSlots[segment], lastSlot, changedSlots);
+                mesh.numVertices[type] -= 2;
+                mesh.firstVertex[type + 1] -= 2;
+                mesh.numVertices[type + 1] += 2;
+            }
+            for (int type = oldType; type > newType; type--) {
+                const int firstSlot = mesh.firstVertex[type] / 2;
+                swapSlots(mesh, mesh.segmentSlots[segment], firstSlot, changedSlots);
+                mesh.firstVertex[type] += 2;
+                mesh.numVertices[type] -= 2;
+                mesh.numVertices[type - 1] += 2;
+            }
+            mesh.segmentTypes[segment] = static_cast<u_int8_t>(newType);
+            changedSlots.push_back(mesh.segmentSlots[segment]);
+        }
+    }
+
+    for (const int slot : changedSlots) {
+        writeSlotVertices(mesh, segments, slot);
+    }
+
+    return changedSlots;
+}
+
+void updateBorderMeshSlots(const BorderMesh& mesh, const GLuint VBO, const int firstSlot,
+    const int numSlots) {
+    if (firstSlot < 0 || (firstSlot + numSlots) * 12 > mesh.vertices.size()) {
+        throw std::runtime_error("Slot range is out of bounds; cannot update the border mesh.");
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, firstSlot * 12 * sizeof(float), numSlots * 12 * sizeof(float),
+        mesh.vertices.data() + (firstSlot * 12));
+}
+
+void drawBorderMesh(const BorderMesh& mesh, const std::array<bool, NUM_BORDER_TYPES>& isVisible,
+    const float pixelsPerUnit) {
+    for (int type = 0; type < NUM_BORDER_TYPES; type++) {
+        if (!isVisible[type] || mesh.numVertices[type] == 0) {
+            continue;
+        }
+        if (type == CELL_BORDER && mesh.averageSegmentLength * pixelsPerUnit <
+            MIN_CELL_BORDER_PIXELS) {
+            continue;
+        }
+        glDrawArrays(GL_LINES, mesh.firstVertex[type], mesh.numVertices[type]);
+    }
+}
@@ -0,0 +1,68 @@
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <madoc/camera.h>
+
+
+Camera createCamera(const int worldWidth, const int worldHeight, const int screenWidth,
+    const int screenHeight) {
+    Camera camera;
+
+    // World space has y pointing up, so the grid's rows go into negative y
+    camera.position = {worldWidth / 2.0f, -worldHeight / 2.0f};
+    camera.zoom = std::min(static_cast<float>(screenWidth) / static_cast<float>(worldWidth),
+        static_cast<float>(screenHeight) / static_cast<float>(worldHeight));
+    camera.minZoom = camera.zoom / 4.0f;
+    camera.maxZoom = 64.0f;
+
+    return camera;
+}
+
+glm::mat4 getViewMatrix(const Camera& camera) {
+    return glm::translate(glm::mat4(1.0f), glm::vec3(-camera.position, 0.0f));
+}
+
+glm::mat4 getProjectionMatrix(const Camera& camera, const int screenWidth,
+    const int screenHeight) {
+    const float halfWidth = static_cast<float>(screenWidth) / (2.0f * camera.zoom);
+    const float halfHeight = static_cast<float>(screenHeight) / (2.0f * camera.zoom);
+
+    return glm::ortho(-halfWidth, halfWidth, -halfHeight, halfHeight, -1.0f, 1.0f);
+}
+
+void getCameraBounds(const Camera& camera, const int screenWidth, const int screenHeight,
+    glm::vec2& boundsMin, glm::vec2& boundsMax) {
+    const glm::vec2 halfSize = {static_cast<float>(screenWidth) / (2.0f * camera.zoom),
+        static_cast<float>(screenHeight) / (2.0f * camera.zoom)};
+
+    boundsMin = camera.position - halfSize;
+    boundsMax = camera.position + halfSize;
+}
+
+glm::vec2 screenToWorld(const Camera& camera, const int screenWidth, const int screenHeight,
+    const glm::vec2 screenPosition) {
+    // Screen y points down, world y points up
+    const glm::vec2 fromCenter = {screenPosition.x - (screenWidth / 2.0f),
+        (screenHeight / 2.0f) - screenPosition.y};
+
+    return camera.position + (fromCenter / camera.zoom);
+}
+
+void panCamera(Camera& camera, const glm::vec2 screenDelta) {
+    camera.position += screenDelta / camera.zoom;
+}
+
+void zoomCamera(Camera& camera, const float factor, const glm::vec2 anchor) {
+    const float newZoom = std::clamp(camera.zoom * factor, camera.minZoom, camera.maxZoom);
+
+    // Scale the anchor's offset from the center so it stays under the cursor
+    camera.position = anchor + ((camera.position - anchor) * (camera.zoom / newZoom));
+    camera.zoom = newZoom;
+}
+
+bool isBoxVisible(const glm::vec2 boxMin, const glm::vec2 boxMax, const glm::vec2 boundsMin,
+    const glm::vec2 boundsMax) {
+    return boxMin.x <= boundsMax.x && boxMax.x >= boundsMin.x &&
+        boxMin.y <= boundsMax.y && boxMax.y >= boundsMin.y;
+}
@@ -0,0 +1,65 @@
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include <madoc/cell_attributes.h>
+
+
+void packCellColor(std::vector<u_int8_t>& cellColors, const int cellID,
+    const std::vector<float>& color) {
+    if (cellColors.size() < (cellID + 1) * 4) {
+        cellColors.resize((cellID + 1) * 4);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        cellColors[(cellID * 4) + i] =
+            static_cast<u_int8_t>(std::round(glm::clamp(color[i], 0.0f, 1.0f) * 255.0f));
+    }
+    cellColors[(cellID * 4) + 3] = 255;
+}
+
+CellAttributeBuffer createCellAttributeBuffer(const std::vector<u_int8_t>& cellColors) {
+    CellAttributeBuffer attributeBuffer;
+    attributeBuffer.numCells = static_cast<int>(cellColors.size() / 4);
+
+    glGenBuffers(1, &attributeBuffer.buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, attributeBuffer.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, cellColors.size(), cellColors.data(), GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &attributeBuffer.texture);
+    glBindTexture(GL_TEXTURE_BUFFER, attributeBuffer.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, attributeBuffer.buffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    return attributeBuffer;
+}
+
+void updateCellColors(const CellAttributeBuffer& attributeBuffer,
+    const std::vector<u_int8_t>& cellColors, const int firstCell, const int numCells) {
+    if (firstCell < 0 || firstCell + numCells > attributeBuffer.numCells ||
+        (firstCell + numCells) * 4 > cellColors.size()) {
+        throw std::runtime_error("Cell color range is out of bounds; "
+                                 "cannot update the cell attribute buffer.");
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, attributeBuffer.buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, firstCell * 4, numCells * 4,
+        cellColors.data() + (firstCell * 4));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void bindCellAttributeBuffer(const CellAttributeBuffer& attributeBuffer,
+    const GLint samplerLocation, const int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, attributeBuffer.texture);
+    glUniform1i(samplerLocation, textureUnit);
+}
+
+void deleteCellAttributeBuffer(CellAttributeBuffer& attributeBuffer) {
+    glDeleteTextures(1, &attributeBuffer.texture);
+    glDeleteBuffers(1, &attributeBuffer.buffer);
+    attributeBuffer.numCells = 0;
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+
+#include <madoc/cell_graph.h>
+
+
+CellGraph createCellGraph(const std::vector<std::vector<int>>& neighborLists) {
+    CellGraph graph;
+    graph.numCells = static_cast<int>(neighborLists.size());
+    graph.offsets.resize(graph.numCells + 1);
+
+    graph.offsets[0] = 0;
+    for (int i = 0; i < graph.numCells; i++) {
+        graph.offsets[i + 1] = graph.offsets[i] + static_cast<int>(neighborLists[i].size());
+    }
+    graph.neighbors.reserve(graph.offsets[graph.numCells]);
+    for (const std::vector<int>& neighborList : neighborLists) {
+        graph.neighbors.insert(graph.neighbors.end(), neighborList.begin(), neighborList.end());
+    }
+
+    return graph;
+}
+
+CellGraph createGridCellGraph(const VoronoiGrid& inputGrid) {
+    // Collect every pair of different labels that touch to the right or below
+    std::vector<std::pair<int, int>> edges;
+    for (int y = 0; y < inputGrid.height; y++) {
+        for (int x = 0; x < inputGrid.width; x++) {
+            const int cell = inputGrid.cells[(y * inputGrid.width) + x];
+            if (x + 1 < inputGrid.width) {
+                const int right = inputGrid.cells[(y * inputGrid.width) + x + 1];
+                if (right != cell) {
+                    edges.push_back({cell, right});
+                    edges.push_back({right, cell});
+                }
+            }
+            if (y + 1 < inputGrid.height) {
+                const int below = inputGrid.cells[((y + 1) * inputGrid.width) + x];
+                if (below != cell) {
+                    edges.push_back({cell, below});
+                    edges.push_back({below, cell});
+                }
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    CellGraph graph;
+    graph.numCells = inputGrid.numFeaturePoints;
+    graph.offsets.assign(graph.numCells + 1, 0);
+    for (const std::pair<int, int>& edge : edges) {
+        graph.offsets[edge.first + 1]++;
+    }
+    for (int i = 0; i < graph.numCells; i++) {
+        graph.offsets[i + 1] += graph.offsets[i];
+    }
+    graph.neighbors.reserve(edges.size());
+    for (const std::pair<int, int>& edge : edges) {
+        graph.neighbors.push_back(edge.second);
+    }
+
+    return graph;
+}
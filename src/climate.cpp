@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cmath>
+
+#include <madoc/biome_generator.h>
+#include <madoc/climate.h>
+#include <madoc/task_scheduler.h>
+
+
+// Bands are counted from the top of the world down, so the middle band of
+// each hemisphere is the westerlies and the rest blow west
+static bool windBlowsEast(const int band) {
+    const int numBands = 2 * WIND_BANDS_PER_HEMISPHERE;
+    return std::min(band, numBands - 1 - band) == 1;
+}
+
+Climate generateClimate(const CellGraph& graph, const std::vector<glm::vec2>& cellCentroids,
+    const std::vector<float>& elevation, const float seaLevel, const int worldWidth,
+    const int worldHeight) {
+    const int numCells = graph.numCells;
+    const int numBands = 2 * WIND_BANDS_PER_HEMISPHERE;
+    Climate climate;
+    climate.temperature.resize(numCells);
+    climate.precipitation.resize(numCells);
+    climate.rainfall.resize(numCells);
+
+    // Sort the cells by band, then by grid column in the direction the wind
+    // blows, with a counting sort, then by exact position along the wind
+    // within each column. Every cell's upwind neighbors in the same band are
+    // then swept before it, even ones in the same column.
+    std::vector<int> band(numCells);
+    std::vector<int> column(numCells);
+    std::vector<float> downwind(numCells);
+    std::vector<int> bucketOffsets((numBands * worldWidth) + 1, 0);
+    for (int i = 0; i < numCells; i++) {
+        const glm::vec2 centroid = cellCentroids[i];
+        climate.temperature[i] = generateTemperature(centroid.y,
+            static_cast<float>(worldHeight), 1.0f);
+
+        const float latitude = std::clamp(-centroid.y / static_cast<float>(worldHeight),
+            0.0f, 1.0f);
+        band[i] = std::min(static_cast<int>(latitude * numBands), numBands - 1);
+        column[i] = std::clamp(static_cast<int>(centroid.x), 0, worldWidth - 1);
+        downwind[i] = centroid.x;
+        if (!windBlowsEast(band[i])) {
+            column[i] = worldWidth - 1 - column[i];
+            downwind[i] = -centroid.x;
+        }
+        bucketOffsets[(band[i] * worldWidth) + column[i] + 1]++;
+    }
+    for (int i = 0; i < numBands * worldWidth; i++) {
+        bucketOffsets[i + 1] += bucketOffsets[i];
+    }
+    std::vector<int> sweepOrder(numCells);
+    std::vector<int> bucketFill(bucketOffsets.begin(), bucketOffsets.end() - 1);
+    for (int i = 0; i < numCells; i++) {
+        sweepOrder[bucketFill[(band[i] * worldWidth) + column[i]]++] = i;
+    }
+    // Columns only hold a cell or two, and are already in index order, so
+    // the stable sort keeps ties deterministic
+    for (int i = 0; i < numBands * worldWidth; i++) {
+        std::stable_sort(sweepOrder.begin() + bucketOffsets[i],
+            sweepOrder.begin() + bucketOffsets[i + 1], [&downwind](const int a, const int b) {
+                return downwind[a] < downwind[b];
+            });
+    }
+    std::vector<int> sweepPosition(numCells);
+    for (int i = 0; i < numCells; i++) {
+        sweepPosition[sweepOrder[i]] = i;
+    }
+
+    // How much moisture is left in the air as it leaves each cell
+    std::vector<float> moisture(numCells);
+    auto sweepBand = [&](const int currentBand) {
+        const glm::vec2 wind = windBlowsEast(currentBand) ? glm::vec2(1.0f, 0.0f) :
+            glm::vec2(-1.0f, 0.0f);
+        const int start = bucketOffsets[currentBand * worldWidth];
+        const int end = bucketOffsets[(currentBand + 1) * worldWidth];
+
+        for (int i = start; i < end; i++) {
+            const int cell = sweepOrder[i];
+
+            // The sea tops the air back up to saturation
+            if (elevation[cell] < seaLevel) {
+                moisture[cell] = 1.0f;
+                climate.precipitation[cell] = 1.0f;
+                climate.rainfall[cell] = 0.0f;
+                continue;
+            }
+
+            // The air coming in is a mix of what left the upwind neighbors,
+            // weighted by how squarely the wind carries it across
+            float weightSum = 0.0f;
+            float incoming = 0.0f;
+            float distance = 0.0f;
+            float neighborDistance = 0.0f;
+            for (int j = graph.offsets[cell]; j < graph.offsets[cell + 1]; j++) {
+                const int neighbor = graph.neighbors[j];
+                const glm::vec2 offset = cellCentroids[cell] - cellCentroids[neighbor];
+                const float offsetLength = glm::length(offset);
+                neighborDistance = std::max(neighborDistance, offsetLength);
+                if (band[neighbor] != currentBand || sweepPosition[neighbor] >= i ||
+                    offsetLength == 0.0f) {
+                    continue;
+                }
+                const float weight = std::max(glm::dot(offset, wind) / offsetLength, 0.0f);
+                weightSum += weight;
+                incoming += weight * moisture[neighbor];
+                distance += weight * glm::dot(offset, wind);
+            }
+            if (weightSum > 0.0f) {
+                incoming /= weightSum;
+                distance /= weightSum;
+            }
+            else {
+                // Every neighbor upwind is across the band's edge, where the
+                // other band's air can't be read, so take the air from the
+                // nearest cell already swept in this band instead. Cells
+                // swept earlier are only further upwind, so the search stops
+                // once they're further along the wind than the best so far.
+                // Only cells at the upwind edge of the world, with nothing in
+                // reach, get air straight off the open sea beyond it.
+                const float maxCarryDistance = CLIMATE_CARRY_RANGE * neighborDistance;
+                float carryDistance = maxCarryDistance;
+                int source = -1;
+                for (int j = i - 1; j >= start; j--) {
+                    const int candidate = sweepOrder[j];
+                    if (downwind[cell] - downwind[candidate] > carryDistance) {
+                        break;
+                    }
+                    const float candidateDistance =
+                        glm::length(cellCentroids[cell] - cellCentroids[candidate]);
+                    if (candidateDistance < carryDistance) {
+                        carryDistance = candidateDistance;
+                        source = candidate;
+                    }
+                }
+                if (source != -1) {
+                    incoming = moisture[source];
+                    distance = downwind[cell] - downwind[source];
+                }
+                else {
+                    incoming = 1.0f;
+                }
+            }
+
+            // Whatever the air can't hold at this elevation rains out, and a
+            // little more rains out over the distance it travels
+            const float capacity = std::clamp(1.0f - (MOISTURE_LAPSE_RATE *
+                (elevation[cell] - seaLevel)), 0.0f, 1.0f);
+            float rain = std::max(incoming - capacity, 0.0f);
+            rain += (incoming - rain) * (1.0f - std::exp(-BASE_RAIN_RATE * distance));
+
+            moisture[cell] = incoming - rain;
+            climate.precipitation[cell] = incoming;
+            climate.rainfall[cell] = rain / std::max(distance, 1.0f);
+        }
+    };
+
+    // Bands never read each other's cells, so each one can be swept as its
+    // own task
+    parallelFor(0, numBands, 1, [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++) {
+            sweepBand(i);
+        }
+    });
+
+    return climate;
+}
@@ -0,0 +1,307 @@
+#include <algorithm>
+
+#include <madoc/contour_simplification.h>
+
+
+/*
+ * Returns whether the bitmask is filled at the given bitmask coordinates,
+ * treating anything outside of it as empty.
+ */
+bool isFilled(const VoronoiBitmask& bitmask, const int x, const int y) {
+    if (x < 0 || y < 0 || x >= bitmask.width || y >= bitmask.height) {
+        return false;
+    }
+    return bitmask.mask[(y * bitmask.width) + x];
+}
+
+std::vector<glm::ivec2> traceCellCorners(const VoronoiBitmask& bitmask) {
+    std::vector<glm::ivec2> corners;
+
+    // Start at the top left corner of the first filled grid cell. Its top edge
+    // is always on the outside of the cell.
+    int startingCell = -1;
+    for (int i = 0; i < bitmask.mask.size(); i++) {
+        if (bitmask.mask[i]) {
+            startingCell = i;
+            break;
+        }
+    }
+    if (startingCell < 0) {
+        return corners;
+    }
+
+    // Corner (x, y) is the top left corner of grid cell (x, y). Directions
+    // are EAST, SOUTH, WEST, NORTH, which is clockwise on screen.
+    const int stepX[4] = {1, 0, -1, 0};
+    const int stepY[4] = {0, 1, 0, -1};
+    // Offsets from a corner to the grid cells ahead-left and ahead-right of it
+    const int leftX[4] = {0, 0, -1, -1};
+    const int leftY[4] = {-1, 0, 0, -1};
+    const int rightX[4] = {0, -1, -1, 0};
+    const int rightY[4] = {0, 0, -1, -1};
+
+    const int startingX = startingCell % bitmask.width;
+    const int startingY = startingCell / bitmask.width;
+    int cornerX = startingX;
+    int cornerY = startingY;
+    int direction = 0;
+
+    // Walk along the outside of the cell, always keeping it on the right
+    const int maxSteps = 4 * static_cast<int>(bitmask.mask.size()) + 4;
+    for (int step = 0; step < maxSteps; step++) {
+        corners.push_back({cornerX - 1 + bitmask.xOffset, cornerY - 1 + bitmask.yOffset});
+        cornerX += stepX[direction];
+        cornerY += stepY[direction];
+        if (cornerX == startingX && cornerY == startingY) {
+            break;
+        }
+
+        // Grid cells that only touch diagonally aren't connected, so only turn
+        // left when both cells ahead are filled
+        const bool isLeftFilled = isFilled(bitmask, cornerX + leftX[direction],
+            cornerY + leftY[direction]);
+        const bool isRightFilled = isFilled(bitmask, cornerX + rightX[direction],
+            cornerY + rightY[direction]);
+        if (!isRightFilled) {
+            direction = (direction + 1) % 4;
+        }
+        else if (isLeftFilled) {
+            direction = (direction + 3) % 4;
+        }
+    }
+
+    return corners;
+}
+
+/*
+ * Returns the voronoiID at the given grid coordinates, or WORLD_EDGE if the
+ * coordinates are outside of the grid.
+ */
+int getCellID(const VoronoiGrid& inputGrid, const int x, const int y) {
+    if (x < 0 || y < 0 || x >= inputGrid.width || y >= inputGrid.height) {
+        return WORLD_EDGE;
+    }
+    return inputGrid.cells[(y * inputGrid.width) + x];
+}
+
+bool isJunction(const VoronoiGrid& inputGrid, const int cornerX, const int cornerY) {
+    // Corners of the world have to stay put, or the map's corners get cut off
+    if ((cornerX == 0 || cornerX == inputGrid.width) &&
+        (cornerY == 0 || cornerY == inputGrid.height)) {
+        return true;
+    }
+
+    const int northWest = getCellID(inputGrid, cornerX - 1, cornerY - 1);
+    const int northEast = getCellID(inputGrid, cornerX, cornerY - 1);
+    const int southWest = getCellID(inputGrid, cornerX - 1, cornerY);
+    const int southEast = getCellID(inputGrid, cornerX, cornerY);
+
+    // Two cells touching diagonally pinch the border into a point
+    if (northWest == southEast && northEast == southWest && northWest != northEast) {
+        return true;
+    }
+
+    int numDistinct = 1;
+    if (northEast != northWest) { numDistinct++; }
+    if (southWest != northWest && southWest != northEast) { numDistinct++; }
+    if (southEast != northWest && southEast != northEast && southEast != southWest) {
+        numDistinct++;
+    }
+
+    return numDistinct >= 3;
+}
+
+/*
+ * Distance from a point to the line segment between a and b
+ */
+float getSegmentDistance(const glm::vec2& point, const glm::vec2& a, const glm::vec2& b) {
+    const glm::vec2 segment = b - a;
+    const float lengthSquared = glm::dot(segment, segment);
+    if (lengthSquared == 0.0f) {
+        return glm::length(point - a);
+    }
+
+    const float t = glm::clamp(glm::dot(point - a, segment) / lengthSquared, 0.0f, 1.0f);
+    return glm::length(point - (a + (t * segment)));
+}
+
+std::vector<glm::vec2> simplifyDouglasPeucker(const std::vector<glm::vec2>& points,
+    const float tolerance) {
+    if (points.size() <= 2) {
+        return points;
+    }
+
+    std::vector<bool> isKept(points.size(), false);
+    isKept.front() = true;
+    isKept.back() = true;
+
+    // Iterative version, so very long borders can't overflow the stack
+    std::vector<std::pair<int, int>> ranges = {{0, static_cast<int>(points.size()) - 1}};
+    while (!ranges.empty()) {
+        const auto [first, last] = ranges.back();
+        ranges.pop_back();
+
+        float farthestDistance = 0.0f;
+        int farthestPoint = -1;
+        for (int i = first + 1; i < last; i++) {
+            const float distance = getSegmentDistance(points[i], points[first], points[last]);
+            if (distance > farthestDistance) {
+                farthestDistance = distance;
+                farthestPoint = i;
+            }
+        }
+
+        if (farthestPoint >= 0 && farthestDistance > tolerance) {
+            isKept[farthestPoint] = true;
+            ranges.push_back({first, farthestPoint});
+            ranges.push_back({farthestPoint, last});
+        }
+    }
+
+    std::vector<glm::vec2> simplifiedPoints;
+    for (int i = 0; i < points.size(); i++) {
+        if (isKept[i]) {
+            simplifiedPoints.push_back(points[i]);
+        }
+    }
+
+    return simplifiedPoints;
+}
+
+/*
+ * Returns whether a chain reads "smaller" backwards than forwards. Both cells
+ * that share a chain agree on this, since one sees the other's reverse.
+ */
+bool isReversedSmaller(const std::vector<glm::vec2>& points) {
+    int front = 0;
+    int back = static_cast<int>(points.size()) - 1;
+    while (front < points.size()) {
+        const glm::vec2& forward = points[front];
+        const glm::vec2& backward = points[back];
+        if (forward.x != backward.x) { return backward.x < forward.x; }
+        if (forward.y != backward.y) { return backward.y < forward.y; }
+        front++;
+        back--;
+    }
+
+    return false;
+}
+
+std::vector<OutlineChain> getOutlineChains(const VoronoiGrid& inputGrid,
+    const VoronoiBitmask& bitmask, const u_int16_t voronoiID) {
+    std::vector<OutlineChain> chains;
+    const std::vector<glm::ivec2> corners = traceCellCorners(bitmask);
+    const int numCorners = static_cast<int>(corners.size());
+    if (numCorners < 4) {
+        return chains;
+    }
+
+    // Merge collinear runs, keeping every corner that turns or is a junction
+    std::vector<glm::ivec2> outline;
+    std::vector<bool> isOutlineJunction;
+    for (int i = 0; i < numCorners; i++) {
+        const glm::ivec2& previous = corners[(i - 1 + numCorners) % numCorners];
+        const glm::ivec2& current = corners[i];
+        const glm::ivec2& next = corners[(i + 1) % numCorners];
+        const bool isCornerJunction = isJunction(inputGrid, current.x, current.y);
+        if (isCornerJunction || (current - previous) != (next - current)) {
+            outline.push_back(current);
+            isOutlineJunction.push_back(isCornerJunction);
+        }
+    }
+
+    // Rotate the outline so it starts at a junction. A cell with no junctions
+    // is surrounded by one other cell, so its smallest point is used instead.
+    int firstJunction = static_cast<int>(std::find(isOutlineJunction.begin(),
+        isOutlineJunction.end(), true) - isOutlineJunction.begin());
+    if (firstJunction == outline.size()) {
+        firstJunction = 0;
+        for (int i = 1; i < outline.size(); i++) {
+            if (outline[i].x < outline[firstJunction].x ||
+                (outline[i].x == outline[firstJunction].x && outline[i].y < outline[firstJunction].y)) {
+                firstJunction = i;
+            }
+        }
+        isOutlineJunction[firstJunction] = true;
+    }
+    std::rotate(outline.begin(), outline.begin() + firstJunction, outline.end());
+    std::rotate(isOutlineJunction.begin(), isOutlineJunction.begin() + firstJunction,
+        isOutlineJunction.end());
+
+    // Cut the outline into chains at every junction
+    const int numOutline = static_cast<int>(outline.size());
+    int chainStart = 0;
+    while (chainStart < numOutline) {
+        int chainEnd = chainStart + 1;
+        while (chainEnd < numOutline && !isOutlineJunction[chainEnd]) {
+            chainEnd++;
+        }
+
+        OutlineChain chain;
+        for (int i = chainStart; i <= chainEnd; i++) {
+            const glm::ivec2& point = outline[i % numOutline];
+            chain.points.push_back({static_cast<float>(point.x), static_cast<float>(point.y)});
+        }
+
+        // The cell on the other side sits to the left of the chain's first edge
+        const glm::ivec2 edgeStart = outline[chainStart];
+        const glm::ivec2 edgeStep = glm::sign(outline[(chainStart + 1) % numOutline] - edgeStart);
+        const int leftOffsetX[4] = {0, 0, -1, -1};
+        const int leftOffsetY[4] = {-1, 0, 0, -1};
+        int direction = 0;
+        if (edgeStep.y > 0) { direction = 1; }
+        else if (edgeStep.x < 0) { direction = 2; }
+        else if (edgeStep.y < 0) { direction = 3; }
+        chain.neighborID = getCellID(inputGrid, edgeStart.x + leftOffsetX[direction],
+            edgeStart.y + leftOffsetY[direction]);
+        if (chain.neighborID == voronoiID) {
+            chain.neighborID = WORLD_EDGE;
+        }
+
+        chains.push_back(chain);
+        chainStart = chainEnd;
+    }
+
+    return chains;
+}
+
+std::vector<OutlineChain> simplifyOutlineChains(const std::vector<OutlineChain>& chains,
+    const float tolerance) {
+    std::vector<OutlineChain> simplifiedChains = chains;
+
+    // Simplify in the canonical direction so both sides match
+    for (int i = 0; i < simplifiedChains.size(); i++) {
+        std::vector<glm::vec2>& points = simplifiedChains[i].points;
+        if (isReversedSmaller(points)) {
+            std::reverse(points.begin(), points.end());
+            points = simplifyDouglasPeucker(points, tolerance);
+            std::reverse(points.begin(), points.end());
+        }
+        else {
+            points = simplifyDouglasPeucker(points, tolerance);
+        }
+    }
+
+    return simplifiedChains;
+}
+
+std::vector<float> getChainVertices(const std::vector<OutlineChain>& chains) {
+    std::vector<float> edgeVertices;
+
+    // Each chain ends where the next one starts, so skip its last point
+    for (int i = 0; i < chains.size(); i++) {
+        for (int j = 0; j + 1 < chains[i].points.size(); j++) {
+            edgeVertices.push_back(chains[i].points[j].x);
+            edgeVertices.push_back(-chains[i].points[j].y);
+            edgeVertices.push_back(0.0f);
+        }
+    }
+
+    return edgeVertices;
+}
+
+std::vector<float> getSimplifiedEdgeVertices(const VoronoiGrid& inputGrid,
+    const VoronoiBitmask& bitmask, const u_int16_t voronoiID, const float tolerance) {
+    return getChainVertices(simplifyOutlineChains(
+        getOutlineChains(inputGrid, bitmask, voronoiID), tolerance));
+}
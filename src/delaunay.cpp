@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <madoc/delaunay.h>
+
+
+// Whether r is on the left of the line from p to q (with y pointing up)
+static bool isLeftTurn(const glm::dvec2 p, const glm::dvec2 q, const glm::dvec2 r) {
+    return ((q.x - p.x) * (r.y - p.y)) - ((q.y - p.y) * (r.x - p.x)) > 0.0;
+}
+
+// Whether p is inside the circumcircle of the clockwise triangle a, b, c
+static bool isInCircumcircle(const glm::dvec2 a, const glm::dvec2 b, const glm::dvec2 c,
+    const glm::dvec2 p) {
+    const glm::dvec2 d = a - p;
+    const glm::dvec2 e = b - p;
+    const glm::dvec2 f = c - p;
+    const double ap = glm::dot(d, d);
+    const double bp = glm::dot(e, e);
+    const double cp = glm::dot(f, f);
+
+    return (d.x * ((e.y * cp) - (bp * f.y))) - (d.y * ((e.x * cp) - (bp * f.x))) +
+        (ap * ((e.x * f.y) - (e.y * f.x))) < 0.0;
+}
+
+// Center of the circle through a, b and c, relative to a
+static glm::dvec2 getRelativeCircumcenter(const glm::dvec2 a, const glm::dvec2 b,
+    const glm::dvec2 c) {
+    const glm::dvec2 d = b - a;
+    const glm::dvec2 e = c - a;
+    const double bl = glm::dot(d, d);
+    const double cl = glm::dot(e, e);
+    const double scale = 0.5 / ((d.x * e.y) - (d.y * e.x));
+
+    return {((e.y * bl) - (d.y * cl)) * scale, ((d.x * cl) - (e.x * bl)) * scale};
+}
+
+// Maps a direction to [0, 1) in the same order as its angle, without any trig
+static double getPseudoAngle(const glm::dvec2 direction) {
+    const double p = direction.x / (std::abs(direction.x) + std::abs(direction.y));
+    return (direction.y > 0.0 ? 3.0 - p : 1.0 + p) / 4.0;
+}
+
+// The state of the sweep while points are being added
+struct DelaunaySweep {
+    DelaunayTriangulation& triangulation;
+    glm::dvec2 center = {0.0, 0.0};
+    int hullStart = -1;
+    std::vector<int> hullPrev = {}, hullNext = {}, hullTri = {};
+    std::vector<int> hullHash = {};
+    std::vector<int> edgeStack = {};
+
+    int getHashKey(const glm::dvec2 point) const {
+        const int hashSize = static_cast<int>(hullHash.size());
+        return static_cast<int>(std::floor(getPseudoAngle(point - center) * hashSize)) % hashSize;
+    }
+
+    void link(const int a, const int b) {
+        triangulation.halfedges[a] = b;
+        if (b != -1) {
+            triangulation.halfedges[b] = a;
+        }
+    }
+
+    int addTriangle(const int i0, const int i1, const int i2, const int a, const int b,
+        const int c) {
+        const int t = static_cast<int>(triangulation.triangles.size());
+        triangulation.triangles.insert(triangulation.triangles.end(), {i0, i1, i2});
+        triangulation.halfedges.insert(triangulation.halfedges.end(), {-1, -1, -1});
+        link(t, a);
+        link(t + 1, b);
+        link(t + 2, c);
+
+        return t;
+    }
+
+    // Flips edges starting from half-edge a until the triangles around it are
+    // all Delaunay again. Returns the half-edge that ends up on the hull side.
+    int legalize(int a) {
+        std::vector<int>& triangles = triangulation.triangles;
+        std::vector<int>& halfedges = triangulation.halfedges;
+        const std::vector<glm::dvec2>& points = triangulation.points;
+        int ar = 0;
+
+        while (true) {
+            const int b = halfedges[a];
+            const int a0 = a - (a % 3);
+            ar = a0 + ((a + 2) % 3);
+
+            // Convex hull edges can't be flipped
+            if (b == -1) {
+                if (edgeStack.empty()) {
+                    break;
+                }
+                a = edgeStack.back();
+                edgeStack.pop_back();
+                continue;
+            }
+
+            const int b0 = b - (b % 3);
+            const int al = a0 + ((a + 1) % 3);
+            const int bl = b0 + ((b + 2) % 3);
+            const int p0 = triangles[ar];
+            const int pr = triangles[a];
+            const int pl = triangles[al];
+            const int p1 = triangles[bl];
+
+            if (isInCircumcircle(points[p0], points[pr], points[pl], points[p1])) {
+                triangles[a] = p1;
+                triangles[b] = p0;
+
+                // The flipped edge can be on the hull on the other side, in
+                // which case the hull has to point at its new half-edge
+                const int hbl = halfedges[bl];
+                if (hbl == -1) {
+                    int e = hullStart;
+                    do {
+                        if (hullTri[e] == bl) {
+                            hullTri[e] = a;
+                            break;
+                        }
+                        e = hullPrev[e];
+                    } while (e != hullStart);
+                }
+                link(a, hbl);
+                link(b, halfedges[ar]);
+                link(ar, bl);
+
+                edgeStack.push_back(b0 + ((b + 1) % 3));
+            }
+            else {
+                if (edgeStack.empty()) {
+                    break;
+                }
+                a = edgeStack.back();
+                edgeStack.pop_back();
+            }
+        }
+
+        return ar;
+    }
+};
+
+DelaunayTriangulation triangulateDelaunay(const std::vector<glm::dvec2>& points) {
+    DelaunayTriangulation triangulation;
+    triangulation.points = points;
+    const int numPoints = static_cast<int>(points.size());
+    if (numPoints < 3) {
+        return triangulation;
+    }
+
+    glm::dvec2 boundsMin = points[0];
+    glm::dvec2 boundsMax = points[0];
+    for (const glm::dvec2 point : points) {
+        boundsMin = glm::min(boundsMin, point);
+        boundsMax = glm::max(boundsMax, point);
+    }
+    const glm::dvec2 boundsCenter = (boundsMin + boundsMax) / 2.0;
+
+    // Seed the sweep with the point closest to the middle, its closest point,
+    // and the point that makes the smallest circumcircle with those two
+    int i0 = 0, i1 = -1, i2 = -1;
+    double minDistance = std::numeric_limits<double>::max();
+    for (int i = 0; i < numPoints; i++) {
+        const double distance = glm::dot(points[i] - boundsCenter, points[i] - boundsCenter);
+        if (distance < minDistance) {
+            i0 = i;
+            minDistance = distance;
+        }
+    }
+    minDistance = std::numeric_limits<double>::max();
+    for (int i = 0; i < numPoints; i++) {
+        const double distance = glm::dot(points[i] - points[i0], points[i] - points[i0]);
+        if (i != i0 && distance > 0.0 && distance < minDistance) {
+            i1 = i;
+            minDistance = distance;
+        }
+    }
+    double minRadius = std::numeric_limits<double>::max();
+    for (int i = 0; i < numPoints; i++) {
+        if (i == i0 || i == i1 || i1 == -1) {
+            continue;
+        }
+        const glm::dvec2 relativeCenter = getRelativeCircumcenter(points[i0], points[i1], points[i]);
+        const double radius = glm::dot(relativeCenter, relativeCenter);
+        if (radius < minRadius) {
+            i2 = i;
+            minRadius = radius;
+        }
+    }
+    // Every point is on one line, so there's nothing to triangulate
+    if (i2 == -1) {
+        return triangulation;
+    }
+
+    // The sweep keeps the triangles and hull clockwise
+    if (isLeftTurn(points[i0], points[i1], points[i2])) {
+        std::swap(i1, i2);
+    }
+
+    DelaunaySweep sweep = {triangulation};
+    sweep.center = points[i0] + getRelativeCircumcenter(points[i0], points[i1], points[i2]);
+
+    // Add points in order of how far they are from the seed triangle, which
+    // guarantees each new point is outside the current hull
+    std::vector<int> ids(numPoints);
+    std::iota(ids.begin(), ids.end(), 0);
+    std::vector<double> distances(numPoints);
+    for (int i = 0; i < numPoints; i++) {
+        distances[i] = glm::dot(points[i] - sweep.center, points[i] - sweep.center);
+    }
+    std::sort(ids.begin(), ids.end(), [&](const int a, const int b) {
+        return distances[a] < distances[b];
+    });
+
+    // The hull is a linked list of points, hashed by angle around the center
+    // so the part of it that a new point can see is quick to find
+    sweep.hullPrev.resize(numPoints);
+    sweep.hullNext.resize(numPoints);
+    sweep.hullTri.resize(numPoints);
+    sweep.hullHash.assign(static_cast<int>(std::ceil(std::sqrt(numPoints))), -1);
+    sweep.hullStart = i0;
+    sweep.hullNext[i0] = sweep.hullPrev[i2] = i1;
+    sweep.hullNext[i1] = sweep.hullPrev[i0] = i2;
+    sweep.hullNext[i2] = sweep.hullPrev[i1] = i0;
+    sweep.hullTri[i0] = 0;
+    sweep.hullTri[i1] = 1;
+    sweep.hullTri[i2] = 2;
+    sweep.hullHash[sweep.getHashKey(points[i0])] = i0;
+    sweep.hullHash[sweep.getHashKey(points[i1])] = i1;
+    sweep.hullHash[sweep.getHashKey(points[i2])] = i2;
+
+    const int maxTriangles = std::max((2 * numPoints) - 5, 0);
+    triangulation.triangles.reserve(maxTriangles * 3);
+    triangulation.halfedges.reserve(maxTriangles * 3);
+    sweep.addTriangle(i0, i1, i2, -1, -1, -1);
+
+    std::vector<int>& hullPrev = sweep.hullPrev;
+    std::vector<int>& hullNext = sweep.hullNext;
+    std::vector<int>& hullTri = sweep.hullTri;
+    glm::dvec2 previousPoint;
+    for (int k = 0; k < numPoints; k++) {
+        const int i = ids[k];
+        const glm::dvec2 point = points[i];
+
+        // Skip duplicate points and the seed triangle
+        if (k > 0 && point == previousPoint) {
+            continue;
+        }
+        previousPoint = point;
+        if (i == i0 || i == i1 || i == i2) {
+            continue;
+        }
+
+        // Find a visible edge on the hull, starting from the hull point with
+        // the closest angle
+        int start = 0;
+        const int key = sweep.getHashKey(point);
+        for (int j = 0; j < sweep.hullHash.size(); j++) {
+            start = sweep.hullHash[(key + j) % sweep.hullHash.size()];
+            if (start != -1 && start != hullNext[start]) {
+                break;
+            }
+        }
+        start = hullPrev[start];
+        int e = start;
+        int q = hullNext[e];
+        while (!isLeftTurn(point, points[e], points[q])) {
+            e = q;
+            if (e == start) {
+                e = -1;
+                break;
+            }
+            q = hullNext[e];
+        }
+        // Only happens for near-duplicate points
+        if (e == -1) {
+            continue;
+        }
+
+        // Connect the point to the first visible edge
+        int t = sweep.addTriangle(e, i, hullNext[e], -1, -1, hullTri[e]);
+        hullTri[i] = sweep.legalize(t + 2);
+        hullTri[e] = t;
+
+        // Walk forward along the hull, connecting every other visible edge
+        int n = hullNext[e];
+        q = hullNext[n];
+        while (isLeftTurn(point, points[n], points[q])) {
+            t = sweep.addTriangle(n, i, q, hullTri[i], -1, hullTri[n]);
+            hullTri[i] = sweep.legalize(t + 2);
+            hullNext[n] = n;
+            n = q;
+            q = hullNext[n];
+        }
+
+        // And backward from the other side
+        if (e == start) {
+            q = hullPrev[e];
+            while (isLeftTurn(point, points[q], points[e])) {
+                t = sweep.addTriangle(q, i, e, -1, hullTri[e], hullTri[q]);
+                sweep.legalize(t + 2);
+                hullTri[q] = t;
+                hullNext[e] = e;
+                e = q;
+                q = hullPrev[e];
+            }
+        }
+
+        // The point is now on the hull between e and n
+        sweep.hullStart = hullPrev[i] = e;
+        hullNext[e] = hullPrev[n] = i;
+        hullNext[i] = n;
+        sweep.hullHash[sweep.getHashKey(point)] = i;
+        sweep.hullHash[sweep.getHashKey(points[e])] = e;
+    }
+
+    int e = sweep.hullStart;
+    do {
+        triangulation.hull.push_back(e);
+        e = hullNext[e];
+    } while (e != sweep.hullStart);
+
+    return triangulation;
+}
+
+std::vector<std::vector<int>> getDelaunayNeighbors(const DelaunayTriangulation& triangulation) {
+    std::vector<std::vector<int>> neighbors(triangulation.points.size());
+
+    // Every edge shows up as a half-edge in each direction, except hull edges
+    // which only go one way, so those get added from both ends
+    for (int e = 0; e < triangulation.triangles.size(); e++) {
+        const int from = triangulation.triangles[e];
+        const int to = triangulation.triangles[(e % 3 == 2) ? e - 2 : e + 1];
+        neighbors[from].push_back(to);
+        if (triangulation.halfedges[e] == -1) {
+            neighbors[to].push_back(from);
+        }
+    }
+
+    return neighbors;
+}
+
+std::vector<glm::dvec2> getVoronoiPolygon(const DelaunayTriangulation& triangulation,
+    const std::vector<int>& neighbors, const int pointIndex, const glm::dvec2 boundsMin,
+    const glm::dvec2 boundsMax) {
+    std::vector<glm::dvec2> polygon = {boundsMin, {boundsMax.x, boundsMin.y}, boundsMax,
+        {boundsMin.x, boundsMax.y}};
+    std::vector<glm::dvec2> clipped;
+    const glm::dvec2 point = triangulation.points[pointIndex];
+
+    // Cut away everything closer to each neighbor (Sutherland-Hodgman)
+    for (const int neighbor : neighbors) {
+        const glm::dvec2 normal = triangulation.points[neighbor] - point;
+        const double offset = glm::dot(normal, (triangulation.points[neighbor] + point) / 2.0);
+
+        clipped.clear();
+        for (int i = 0; i < polygon.size(); i++) {
+            const glm::dvec2 current = polygon[i];
+            const glm::dvec2 next = polygon[(i + 1) % polygon.size()];
+            const double currentSide = glm::dot(normal, current) - offset;
+            const double nextSide = glm::dot(normal, next) - offset;
+
+            if (currentSide <= 0.0) {
+                clipped.push_back(current);
+            }
+            if ((currentSide < 0.0 && nextSide > 0.0) || (currentSide > 0.0 && nextSide < 0.0)) {
+                clipped.push_back(current + ((next - current) * (currentSide / (currentSide - nextSide))));
+            }
+        }
+        std::swap(polygon, clipped);
+    }
+
+    return polygon;
+}
+
+DelaunayTriangulation triangulateFeaturePoints(const VoronoiGrid& inputGrid) {
+    std::vector<glm::dvec2> points(inputGrid.numFeaturePoints);
+    for (int i = 0; i < inputGrid.numFeaturePoints; i++) {
+        const FeaturePoint* featurePoint = inputGrid.featurePointPointers[i];
+        points[i] = {featurePoint->x + 0.5, featurePoint->y + 0.5};
+    }
+
+    return triangulateDelaunay(points);
+}
+
+std::vector<float> getVoronoiCellVertices(const VoronoiGrid& inputGrid,
+    const DelaunayTriangulation& triangulation, const std::vector<int>& neighbors,
+    const u_int16_t voronoiID) {
+    std::vector<glm::dvec2> polygon = getVoronoiPolygon(triangulation, neighbors, voronoiID,
+        {0.0, 0.0}, {inputGrid.width, inputGrid.height});
+
+    // Flip y over into world space, which also flips the winding to clockwise
+    std::vector<float> vertices;
+    vertices.reserve(polygon.size() * 3);
+    for (const glm::dvec2 point : polygon) {
+        vertices.insert(vertices.end(), {static_cast<float>(point.x),
+            -static_cast<float>(point.y), 0.0f});
+    }
+
+    return vertices;
+}
+
+std::vector<unsigned int> getFanIndices(const int numVertices) {
+    std::vector<unsigned int> indices;
+    indices.reserve(std::max(numVertices - 2, 0) * 3);
+    for (int i = 1; i + 1 < numVertices; i++) {
+        indices.insert(indices.end(), {0, static_cast<unsigned int>(i),
+            static_cast<unsigned int>(i + 1)});
+    }
+
+    return indices;
+}
@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <madoc/generation_server.h>
+#include <madoc/log_utils.h>
+#include <madoc/task_scheduler.h>
+
+
+// One client's input and output. Responses from different workers are
+// written whole under the mutex, and the output is closed once the last
+// request holding on to it is done.
+struct ServerConnection {
+    int inputFd, outputFd;
+    std::mutex writeMutex;
+    bool isBroken;
+
+    ServerConnection(int input, int output);
+    ~ServerConnection();
+};
+
+struct GenerationRequest {
+    u_int32_t requestID;
+    int seed;
+    int width, height;
+    int macroWidth, macroHeight;
+    int minPoints, maxPoints;
+    std::shared_ptr<ServerConnection> connection;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+// The request queue, the workers that drain it and the latency record they
+// keep, shared by every connection
+struct GenerationServer {
+    const WorldSettings& baseSettings;
+    const BiomeTable& biomeTable;
+
+    std::mutex queueMutex = {};
+    std::condition_variable queueChanged = {};
+    std::deque<GenerationRequest> queue = {};
+    bool isStopping = false;
+
+    std::mutex statsMutex = {};
+    u_int64_t numCompleted = 0;
+    std::vector<double> latencies = {};
+};
+
+ServerConnection::ServerConnection(const int input, const int output) :
+    inputFd(input), outputFd(output), isBroken(false) {}
+
+ServerConnection::~ServerConnection() {
+    if (outputFd != STDOUT_FILENO) {
+        close(outputFd);
+    }
+}
+
+// Reads exactly size bytes, or returns false if the input ends first
+static bool readBytes(const int fd, void* data, const size_t size) {
+    size_t numRead = 0;
+    while (numRead < size) {
+        const ssize_t result = read(fd, static_cast<char*>(data) + numRead, size - numRead);
+        if (result <= 0) {
+            return false;
+        }
+        numRead += result;
+    }
+    return true;
+}
+
+static bool writeBytes(const int fd, const void* data, const size_t size) {
+    size_t numWritten = 0;
+    while (numWritten < size) {
+        const ssize_t result = write(fd, static_cast<const char*>(data) + numWritten,
+            size - numWritten);
+        if (result <= 0) {
+            return false;
+        }
+        numWritten += result;
+    }
+    return true;
+}
+
+template <typename T>
+static void appendValue(std::vector<u_int8_t>& message, const T value) {
+    const size_t offset = message.size();
+    message.resize(offset + sizeof(T));
+    std::memcpy(message.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static void appendArray(std::vector<u_int8_t>& message, const std::vector<T>& values) {
+    const size_t offset = message.size();
+    message.resize(offset + (values.size() * sizeof(T)));
+    std::memcpy(message.data() + offset, values.data(), values.size() * sizeof(T));
+}
+
+template <typename T>
+static T readValue(const std::vector<u_int8_t>& message, size_t& offset) {
+    if (offset + sizeof(T) > message.size()) {
+        throw std::runtime_error("Request is too short");
+    }
+    T value;
+    std::memcpy(&value, message.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return value;
+}
+
+// Starts a response with room for its length, which sendMessage() fills in
+static std::vector<u_int8_t> createResponse(const u_int32_t type, const u_int32_t requestID,
+    const u_int32_t status) {
+    std::vector<u_int8_t> message;
+    appendValue<u_int32_t>(message, 0);
+    appendValue(message, type);
+    appendValue(message, requestID);
+    appendValue(message, status);
+    return message;
+}
+
+static void sendMessage(ServerConnection& connection, std::vector<u_int8_t>& message) {
+    const u_int32_t length = static_cast<u_int32_t>(message.size() - sizeof(u_int32_t));
+    std::memcpy(message.data(), &length, sizeof(u_int32_t));
+
+    std::lock_guard<std::mutex> lock(connection.writeMutex);
+    if (!connection.isBroken && !writeBytes(connection.outputFd, message.data(), message.size())) {
+        connection.isBroken = true;
+        logWarning("generation_server", "Client went away; dropping its responses");
+    }
+}
+
+static void sendError(ServerConnection& connection, const u_int32_t type,
+    const u_int32_t requestID, const ServerStatus status, const std::string& error) {
+    std::vector<u_int8_t> message = createResponse(type, requestID, status);
+    appendValue(message, static_cast<u_int32_t>(error.size()));
+    message.insert(message.end(), error.begin(), error.end());
+    sendMessage(connection, message);
+}
+
+static WorldSettings getRequestSettings(const WorldSettings& baseSettings,
+    const GenerationRequest& request) {
+    if (request.width <= 0 || request.height <= 0 || request.macroWidth <= 0 ||
+        request.macroHeight <= 0 || request.width % request.macroWidth != 0 ||
+        request.height % request.macroHeight != 0) {
+        throw std::runtime_error("A " + std::to_string(request.width) + "x" +
+            std::to_string(request.height) + " world isn't a whole number of " +
+            std::to_string(request.macroWidth) + "x" + std::to_string(request.macroHeight) +
+            " macro cells");
+    }
+    if (static_cast<int64_t>(request.width) * request.height > MAX_WORLD_AREA) {
+        throw std::runtime_error("Worlds can't be bigger than " +
+            std::to_string(MAX_WORLD_AREA) + " grid cells");
+    }
+    if (request.width / request.macroWidth < MIN_WORLD_MACRO_CELLS ||
+        request.height / request.macroHeight < MIN_WORLD_MACRO_CELLS) {
+        throw std::runtime_error("Worlds have to be at least " +
+            std::to_string(MIN_WORLD_MACRO_CELLS) + " macro cells across and down");
+    }
+
+    // Voronoi IDs are 16 bits, every macro cell needs a point, and no two
+    // points in a macro cell can share a grid cell
+    const int64_t numMacroCells = static_cast<int64_t>(request.width / request.macroWidth) *
+        (request.height / request.macroHeight);
+    const int64_t macroArea = static_cast<int64_t>(request.macroWidth) * request.macroHeight;
+    if (request.maxPoints > MAX_POINTS_PER_MACRO_CELL) {
+        throw std::runtime_error("Macro cells can't have more than " +
+            std::to_string(MAX_POINTS_PER_MACRO_CELL) + " points");
+    }
+    if (request.maxPoints > macroArea) {
+        throw std::runtime_error("A " + std::to_string(request.macroWidth) + "x" +
+            std::to_string(request.macroHeight) + " macro cell only has room for " +
+            std::to_string(macroArea) + " points");
+    }
+    if (request.minPoints < 1 || request.maxPoints < request.minPoints ||
+        numMacroCells * request.maxPoints > MAX_FEATURE_POINTS) {
+        throw std::runtime_error("Can't place " + std::to_string(request.minPoints) + " to " +
+            std::to_string(request.maxPoints) + " points in each of " +
+            std::to_string(numMacroCells) + " macro cells");
+    }
+
+    WorldSettings settings = baseSettings;
+    settings.width = request.width;
+    settings.height = request.height;
+    settings.macroWidth = request.macroWidth;
+    settings.macroHeight = request.macroHeight;
+    settings.usePoissonDisk = false;
+    settings.isMeshOnly = true;
+    settings.minPoints = request.minPoints;
+    settings.maxPoints = request.maxPoints;
+    return settings;
+}
+
+static std::vector<u_int8_t> createWorldResponse(const GenerationRequest& request,
+    const World& world) {
+    std::vector<u_int8_t> message = createResponse(GENERATE_MESSAGE, request.requestID,
+        SERVER_OK);
+
+    appendValue<int32_t>(message, world.grid.width);
+    appendValue<int32_t>(message, world.grid.height);
+    appendArray(message, world.grid.cells);
+
+    appendValue<int32_t>(message, world.grid.numFeaturePoints);
+    for (int i = 0; i < world.grid.numFeaturePoints; i++) {
+        appendValue(message, world.cellElevations[i]);
+        appendValue(message, world.climate.temperature[i]);
+        appendValue(message, world.climate.precipitation[i]);
+        appendValue(message, world.cellBiomes[i]);
+        for (int channel = 0; channel < 4; channel++) {
+            appendValue(message, world.cellColors[(i * 4) + channel]);
+        }
+    }
+
+    appendValue<int32_t>(message, world.mesh.numLods);
+    appendValue<int32_t>(message, static_cast<int32_t>(world.mesh.chunks.size()));
+    for (const MeshChunk& chunk : world.mesh.chunks) {
+        for (const ChunkLod& chunkLod : chunk.lods) {
+            appendValue<int32_t>(message, chunkLod.firstIndex);
+            appendValue<int32_t>(message, chunkLod.numIndices);
+            appendValue<int32_t>(message, chunkLod.baseVertex);
+            appendValue<int32_t>(message, chunkLod.numVertices);
+        }
+    }
+    const int numVertices = static_cast<int>(world.mesh.vertices.size() / 6);
+    appendValue<u_int32_t>(message, numVertices);
+    for (int i = 0; i < numVertices; i++) {
+        for (int j = 0; j < 6; j++) {
+            appendValue(message, world.mesh.vertices[(i * 6) + j]);
+        }
+        appendValue(message, world.mesh.vertexCellIDs[i]);
+    }
+    appendValue<u_int32_t>(message, static_cast<u_int32_t>(world.mesh.indices.size()));
+    appendArray(message, world.mesh.indices);
+
+    return message;
+}
+
+static void recordLatency(GenerationServer& server, const GenerationRequest& request) {
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - request.startTime;
+
+    std::lock_guard<std::mutex> lock(server.statsMutex);
+    server.latencies[server.numCompleted % NUM_LATENCY_SAMPLES] = latency.count();
+    server.numCompleted++;
+}
+
+static void runRequestWorker(GenerationServer& server) {
+    while (true) {
+        GenerationRequest request;
+        {
+            std::unique_lock<std::mutex> lock(server.queueMutex);
+            server.queueChanged.wait(lock, [&server]() {
+                return server.isStopping || !server.queue.empty();
+            });
+            if (server.queue.empty()) {
+                return;
+            }
+            request = std::move(server.queue.front());
+            server.queue.pop_front();
+        }
+
+        try {
+            const WorldSettings settings = getRequestSettings(server.baseSettings, request);
+            const World world = generateWorld(settings, server.biomeTable, request.seed);
+            std::vector<u_int8_t> message = createWorldResponse(request, world);
+            sendMessage(*request.connection, message);
+        }
+        catch (const std::exception& error) {
+            sendError(*request.connection, GENERATE_MESSAGE, request.requestID, SERVER_ERROR,
+                error.what());
+        }
+        recordLatency(server, request);
+    }
+}
+
+static void sendStats(GenerationServer& server, ServerConnection& connection) {
+    u_int32_t queueDepth;
+    {
+        std::lock_guard<std::mutex> lock(server.queueMutex);
+        queueDepth = static_cast<u_int32_t>(server.queue.size());
+    }
+
+    u_int64_t numCompleted;
+    std::vector<double> latencies;
+    {
+        std::lock_guard<std::mutex> lock(server.statsMutex);
+        numCompleted = server.numCompleted;
+        latencies.assign(server.latencies.begin(), server.latencies.begin() +
+            std::min<u_int64_t>(numCompleted, NUM_LATENCY_SAMPLES));
+    }
+    auto getPercentile = [&latencies](const double percentile) {
+        if (latencies.empty()) {
+            return 0.0;
+        }
+        const size_t index = std::min(static_cast<size_t>(percentile * latencies.size()),
+            latencies.size() - 1);
+        std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+        return latencies[index];
+    };
+
+    std::vector<u_int8_t> message = createResponse(STATS_MESSAGE, 0, SERVER_OK);
+    appendValue(message, queueDepth);
+    appendValue(message, numCompleted);
+    appendValue(message, getPercentile(0.5));
+    appendValue(message, getPercentile(0.9));
+    appendValue(message, getPercentile(0.99));
+    sendMessage(connection, message);
+}
+
+// Reads requests from a connection until it ends. Generation requests are
+// queued for the workers; everything else is answered right away.
+static void serveConnection(GenerationServer& server,
+    const std::shared_ptr<ServerConnection>& connection) {
+    while (true) {
+        u_int32_t length;
+        if (!readBytes(connection->inputFd, &length, sizeof(length))) {
+            return;
+        }
+        if (length > MAX_REQUEST_LENGTH) {
+            MADOC_LOG(LOG_ERROR, "generation_server",
+                "Request is too long; closing the connection", {"bytes", length});
+            return;
+        }
+        std::vector<u_int8_t> payload(length);
+        if (!readBytes(connection->inputFd, payload.data(), length)) {
+            return;
+        }
+
+        size_t offset = 0;
+        u_int32_t type = 0;
+        GenerationRequest request = {};
+        try {
+            type = readValue<u_int32_t>(payload, offset);
+            if (type == STATS_MESSAGE) {
+                sendStats(server, *connection);
+                continue;
+            }
+            if (type != GENERATE_MESSAGE) {
+                throw std::runtime_error("Unknown message type " + std::to_string(type));
+            }
+            request.requestID = readValue<u_int32_t>(payload, offset);
+            request.seed = readValue<int32_t>(payload, offset);
+            request.width = readValue<int32_t>(payload, offset);
+            request.height = readValue<int32_t>(payload, offset);
+            request.macroWidth = readValue<int32_t>(payload, offset);
+            request.macroHeight = readValue<int32_t>(payload, offset);
+            request.minPoints = readValue<int32_t>(payload, offset);
+            request.maxPoints = readValue<int32_t>(payload, offset);
+        }
+        catch (const std::runtime_error& error) {
+            sendError(*connection, type, request.requestID, SERVER_ERROR, error.what());
+            continue;
+        }
+        request.connection = connection;
+        request.startTime = std::chrono::steady_clock::now();
+
+        bool isQueued = false;
+        {
+            std::lock_guard<std::mutex> lock(server.queueMutex);
+            if (server.queue.size() < MAX_QUEUED_REQUESTS) {
+                server.queue.push_back(std::move(request));
+                isQueued = true;
+            }
+        }
+        if (isQueued) {
+            server.queueChanged.notify_one();
+        }
+        else {
+            sendError(*connection, GENERATE_MESSAGE, request.requestID, SERVER_BUSY,
+                "The request queue is full");
+        }
+    }
+}
+
+static void acceptConnections(GenerationServer& server, const std::string& socketPath) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + socketPath);
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    const int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listenFd == -1 || bind(listenFd, reinterpret_cast<sockaddr*>(&address),
+        sizeof(address)) == -1 || listen(listenFd, SOMAXCONN) == -1) {
+        throw std::runtime_error("Failed to listen on socket " + socketPath + ": " +
+            std::strerror(errno));
+    }
+    MADOC_LOG(LOG_INFO, "generation_server", "Listening on " + socketPath);
+
+    // Each client gets a thread to read its requests, which share the workers
+    while (true) {
+        const int clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd == -1) {
+            logWarning("generation_server", std::string("Failed to accept a client: ") +
+                std::strerror(errno));
+            continue;
+        }
+        std::thread([&server, clientFd]() {
+            serveConnection(server, std::make_shared<ServerConnection>(clientFd, clientFd));
+        }).detach();
+    }
+}
+
+int runGenerationServer(const WorldSettings& baseSettings, const BiomeTable& biomeTable,
+    const std::string& socketPath) {
+    // A client hanging up shouldn't kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    GenerationServer server = {baseSettings, biomeTable};
+    server.isStopping = false;
+    server.numCompleted = 0;
+    server.latencies.resize(NUM_LATENCY_SAMPLES);
+
+    // Start the thread pool now rather than on the first request
+    const int numThreads = getNumWorkerThreads();
+    MADOC_LOG(LOG_INFO, "generation_server", "Ready to generate", {"threads", numThreads},
+        {"worlds_at_a_time", NUM_REQUEST_WORKERS});
+    std::vector<std::thread> workers;
+    for (int i = 0; i < NUM_REQUEST_WORKERS; i++) {
+        workers.emplace_back(runRequestWorker, std::ref(server));
+    }
+
+    int exitCode = 0;
+    try {
+        if (socketPath.empty()) {
+            serveConnection(server,
+                std::make_shared<ServerConnection>(STDIN_FILENO, STDOUT_FILENO));
+        }
+        else {
+            acceptConnections(server, socketPath);
+        }
+    }
+    catch (const std::runtime_error& error) {
+        logError("generation_server", error.what());
+        exitCode = -1;
+    }
+
+    // Finish whatever is still queued before stopping
+    {
+        std::lock_guard<std::mutex> lock(server.queueMutex);
+        server.isStopping = true;
+    }
+    server.queueChanged.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return exitCode;
+}
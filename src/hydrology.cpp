@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <queue>
+
+#include <madoc/hydrology.h>
+#include <madoc/task_scheduler.h>
+
+
+// Levels are split into chunks of this many cells, so the many small levels
+// near the top of the drainage tree run without any threading overhead
+constexpr int FLOW_GRAIN_SIZE = 2048;
+
+
+std::vector<bool> getOutletCells(const VoronoiGrid& inputGrid,
+    const std::vector<float>& elevation, const float seaLevel) {
+    std::vector<bool> isOutlet(inputGrid.numFeaturePoints);
+
+    for (int i = 0; i < inputGrid.numFeaturePoints; i++) {
+        const VoronoiCellStats& stats = inputGrid.cellStats[i];
+        const bool isOnEdge = stats.count > 0 && (stats.minX == 0 || stats.minY == 0 ||
+            stats.maxX == inputGrid.width - 1 || stats.maxY == inputGrid.height - 1);
+        isOutlet[i] = isOnEdge || elevation[i] < seaLevel;
+    }
+
+    return isOutlet;
+}
+
+// Sums the flow of every cell with everything upstream of it. Cells are
+// grouped by their height in the drainage tree, so every cell in a level only
+// reads cells from lower levels and the cells in a level can be summed in
+// parallel without any locking.
+static void accumulateFlow(Hydrology& hydrology, const std::vector<int>& floodOrder,
+    const std::vector<float>& rainfall) {
+    const int numCells = static_cast<int>(floodOrder.size());
+
+    // The flood reaches each cell after the cell it drains into, so walking
+    // the flood backwards visits every cell after everything upstream of it
+    std::vector<int> level(numCells, 0);
+    std::vector<int> upstreamOffsets(numCells + 1, 0);
+    int numLevels = 1;
+    for (int i = numCells - 1; i >= 0; i--) {
+        const int cell = floodOrder[i];
+        const int downstream = hydrology.downstream[cell];
+        if (downstream != -1) {
+            level[downstream] = std::max(level[downstream], level[cell] + 1);
+            upstreamOffsets[downstream + 1]++;
+        }
+        numLevels = std::max(numLevels, level[cell] + 1);
+    }
+
+    // Bucket cells by level, and list each cell's upstream cells
+    std::vector<int> levelOffsets(numLevels + 1, 0);
+    for (int i = 0; i < numCells; i++) {
+        levelOffsets[level[i] + 1]++;
+        upstreamOffsets[i + 1] += upstreamOffsets[i];
+    }
+    for (int i = 0; i < numLevels; i++) {
+        levelOffsets[i + 1] += levelOffsets[i];
+    }
+    std::vector<int> levelCells(numCells);
+    std::vector<int> upstreamCells(upstreamOffsets[numCells]);
+    std::vector<int> levelFill(levelOffsets.begin(), levelOffsets.end() - 1);
+    std::vector<int> upstreamFill(upstreamOffsets.begin(), upstreamOffsets.end() - 1);
+    for (int i = 0; i < numCells; i++) {
+        levelCells[levelFill[level[i]]++] = i;
+        if (hydrology.downstream[i] != -1) {
+            upstreamCells[upstreamFill[hydrology.downstream[i]]++] = i;
+        }
+    }
+
+    // Levels are summed in order, each one split across the scheduler's threads
+    hydrology.flow.resize(numCells);
+    for (int level = 0; level < numLevels; level++) {
+        parallelFor(levelOffsets[level], levelOffsets[level + 1], FLOW_GRAIN_SIZE,
+            [&](const int begin, const int end) {
+                for (int i = begin; i < end; i++) {
+                    const int cell = levelCells[i];
+                    float flow = rainfall[cell];
+                    for (int j = upstreamOffsets[cell]; j < upstreamOffsets[cell + 1]; j++) {
+                        flow += hydrology.flow[upstreamCells[j]];
+                    }
+                    hydrology.flow[cell] = flow;
+                }
+            });
+    }
+}
+
+Hydrology generateHydrology(const CellGraph& graph, const std::vector<float>& elevation,
+    const std::vector<bool>& isOutlet, const std::vector<float>& rainfall) {
+    const int numCells = graph.numCells;
+    Hydrology hydrology;
+    hydrology.filledElevation = elevation;
+    hydrology.isLake.assign(numCells, false);
+    hydrology.downstream.assign(numCells, -1);
+
+    // Priority flood: always grow the flooded area from its lowest cell, so
+    // every cell is reached from the lowest possible spill point. Ties go to
+    // the lower cell ID, which keeps the result deterministic. Cells that get
+    // filled are exactly at their spill level, so they go in a plain FIFO
+    // queue that's drained first instead of the heap (Barnes' pit queue).
+    using FloodEntry = std::pair<float, int>;
+    std::priority_queue<FloodEntry, std::vector<FloodEntry>, std::greater<>> flood;
+    std::queue<int> pits;
+    std::vector<u_int8_t> isFlooded(numCells, false);
+    std::vector<int> floodOrder;
+    floodOrder.reserve(numCells);
+    // Outlets in the open sea can't flood anything, so only the ones next to
+    // land go in the heap, which keeps it small
+    for (int i = 0; i < numCells; i++) {
+        if (!isOutlet[i]) {
+            continue;
+        }
+        isFlooded[i] = true;
+        bool isNextToLand = false;
+        for (int j = graph.offsets[i]; j < graph.offsets[i + 1]; j++) {
+            if (!isOutlet[graph.neighbors[j]]) {
+                isNextToLand = true;
+                break;
+            }
+        }
+        if (isNextToLand) {
+            flood.push({elevation[i], i});
+        }
+        else {
+            floodOrder.push_back(i);
+        }
+    }
+
+    while (!flood.empty() || !pits.empty()) {
+        int cell;
+        if (!pits.empty()) {
+            cell = pits.front();
+            pits.pop();
+        }
+        else {
+            cell = flood.top().second;
+            flood.pop();
+        }
+        floodOrder.push_back(cell);
+
+        for (int j = graph.offsets[cell]; j < graph.offsets[cell + 1]; j++) {
+            const int neighbor = graph.neighbors[j];
+            if (isFlooded[neighbor]) {
+                continue;
+            }
+            isFlooded[neighbor] = true;
+            hydrology.downstream[neighbor] = cell;
+
+            // Cells below the water level around them get filled up into a lake
+            const float spillElevation = hydrology.filledElevation[cell] + FILL_EPSILON;
+            if (elevation[neighbor] <= spillElevation) {
+                hydrology.filledElevation[neighbor] = spillElevation;
+                hydrology.isLake[neighbor] = elevation[neighbor] < hydrology.filledElevation[cell];
+                pits.push(neighbor);
+            }
+            else {
+                flood.push({elevation[neighbor], neighbor});
+            }
+        }
+    }
+
+    // Cells that no outlet can reach (only possible in a disconnected graph)
+    // keep draining nowhere
+    for (int i = 0; i < numCells; i++) {
+        if (!isFlooded[i]) {
+            floodOrder.push_back(i);
+        }
+    }
+
+    accumulateFlow(hydrology, floodOrder, rainfall);
+
+    return hydrology;
+}
+
+std::vector<float> getRiverVertices(const Hydrology& hydrology,
+    const std::vector<glm::vec2>& cellCentroids, const std::vector<float>& elevation,
+    const float seaLevel, const float minFlow) {
+    const glm::vec3 riverColor = {0.196f, 0.392f, 0.902f};
+    std::vector<float> vertices;
+
+    for (int i = 0; i < hydrology.downstream.size(); i++) {
+        const int downstream = hydrology.downstream[i];
+        if (downstream == -1 || hydrology.flow[i] < minFlow || elevation[i] < seaLevel) {
+            continue;
+        }
+        const glm::vec2 from = cellCentroids[i];
+        const glm::vec2 to = cellCentroids[downstream];
+        vertices.insert(vertices.end(), {from.x, from.y, 0.0f,
+            riverColor.r, riverColor.g, riverColor.b});
+        vertices.insert(vertices.end(), {to.x, to.y, 0.0f,
+            riverColor.r, riverColor.g, riverColor.b});
+    }
+
+    return vertices;
+}
@@ -1,16 +1,245 @@
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <madoc/log_utils.h>
 
 
-void logError(const std::string& module, const std::string& message) {
-    std::cerr << "[ERROR] [" << module << "] " << message << std::endl;
+// A message waiting to be written. Its module and message are copied one
+// after the other into text, or into longText if they don't fit.
+struct LogRecord {
+    int64_t time;
+    LogLevel level;
+    u_int32_t moduleLength, messageLength;
+    int numFields;
+    LogField fields[MAX_LOG_FIELDS];
+    char* longText;
+    char text[LOG_INLINE_TEXT_SIZE];
+};
+
+// One thread's records, as a ring that only that thread writes to and only
+// the logger thread reads from, so neither side needs a lock. The two
+// counters live on their own cache lines so they don't bounce between cores.
+struct LogRing {
+    alignas(64) std::atomic<u_int64_t> head;
+    alignas(64) std::atomic<u_int64_t> tail;
+    std::atomic<u_int64_t> numDropped;
+    // Set when the thread exits, after which the ring is freed once drained
+    std::atomic<bool> isAbandoned;
+    LogRecord records[LOG_RING_SIZE];
+};
+
+// The background thread that writes out every thread's records. It starts
+// the first time anything is logged, and writes out whatever is left when
+// the program exits.
+struct Logger {
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    std::mutex wakeMutex;
+    std::condition_variable wakeUp;
+    std::atomic<bool> isWoken;
+    bool isStopping;
+    std::thread thread;
+
+    Logger();
+    ~Logger();
+};
+
+// The calling thread's ring, which it shares with the logger so whichever of
+// them is done with it last frees it
+struct ThreadLogRing {
+    std::shared_ptr<LogRing> ring;
+
+    ~ThreadLogRing();
+};
+
+static thread_local ThreadLogRing threadLogRing;
+
+static Logger& getLogger() {
+    static Logger logger;
+    return logger;
+}
+
+ThreadLogRing::~ThreadLogRing() {
+    if (ring != nullptr) {
+        ring->isAbandoned.store(true, std::memory_order_release);
+    }
+}
+
+static const char* getLevelName(const LogLevel level) {
+    switch (level) {
+        case LOG_DEBUG:
+            return "DEBUG";
+        case LOG_INFO:
+            return "INFO";
+        case LOG_WARNING:
+            return "WARNING";
+        default:
+            return "ERROR";
+    }
+}
+
+static void formatLogRecord(const LogRecord& record, std::string& output) {
+    const char* text = record.longText == nullptr ? record.text : record.longText;
+    output += '[';
+    output += getLevelName(record.level);
+    output += "] [";
+    output.append(text, record.moduleLength);
+    output += "] ";
+    output.append(text + record.moduleLength, record.messageLength);
+
+    char value[32];
+    for (int i = 0; i < record.numFields; i++) {
+        const LogField& field = record.fields[i];
+        switch (field.type) {
+            case LOG_INT_FIELD:
+                std::snprintf(value, sizeof(value), "%lld",
+                    static_cast<long long>(field.intValue));
+                break;
+            case LOG_FLOAT_FIELD:
+                std::snprintf(value, sizeof(value), "%g", field.floatValue);
+                break;
+            case LOG_MILLISECONDS_FIELD:
+                std::snprintf(value, sizeof(value), "%.2fms", field.floatValue);
+                break;
+        }
+        output += ' ';
+        output += field.name;
+        output += '=';
+        output += value;
+    }
+    output += '\n';
+}
+
+// Writes out everything in every ring, in the order it was logged, in one go
+static void writeLogRecords(Logger& logger) {
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(logger.ringsMutex);
+        rings = logger.rings;
+    }
+
+    // Check which threads have exited before reading how far they got, so
+    // an abandoned ring is known to be empty once this drains it
+    std::vector<bool> isAbandoned(rings.size());
+    std::vector<u_int64_t> heads(rings.size());
+    std::vector<const LogRecord*> records;
+    u_int64_t numDropped = 0;
+    for (int i = 0; i < rings.size(); i++) {
+        LogRing& ring = *rings[i];
+        isAbandoned[i] = ring.isAbandoned.load(std::memory_order_acquire);
+        heads[i] = ring.head.load(std::memory_order_acquire);
+        for (u_int64_t j = ring.tail.load(std::memory_order_relaxed); j < heads[i]; j++) {
+            records.push_back(&ring.records[j % LOG_RING_SIZE]);
+        }
+        numDropped += ring.numDropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+        [](const LogRecord* a, const LogRecord* b) { return a->time < b->time; });
+    std::string output;
+    for (const LogRecord* record : records) {
+        formatLogRecord(*record, output);
+        delete[] record->longText;
+    }
+    if (numDropped > 0) {
+        output += "[WARNING] [log_utils] Dropped " + std::to_string(numDropped) +
+            " messages logged faster than they could be written\n";
+    }
+    if (!output.empty()) {
+        std::fwrite(output.data(), 1, output.size(), stderr);
+        std::fflush(stderr);
+    }
+
+    // Only now can the threads reuse the records
+    for (int i = 0; i < rings.size(); i++) {
+        rings[i]->tail.store(heads[i], std::memory_order_release);
+    }
+
+    std::lock_guard<std::mutex> lock(logger.ringsMutex);
+    for (int i = 0; i < rings.size(); i++) {
+        if (isAbandoned[i]) {
+            logger.rings.erase(std::find(logger.rings.begin(), logger.rings.end(), rings[i]));
+        }
+    }
+}
+
+static void runLogger(Logger& logger) {
+    while (true) {
+        bool isStopping;
+        {
+            std::unique_lock<std::mutex> lock(logger.wakeMutex);
+            logger.wakeUp.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS),
+                [&logger]() { return logger.isStopping || logger.isWoken.load(); });
+            logger.isWoken.store(false);
+            isStopping = logger.isStopping;
+        }
+
+        writeLogRecords(logger);
+        if (isStopping) {
+            return;
+        }
+    }
 }
 
-void logWarning(const std::string& module, const std::string& message) {
-    std::cerr << "[WARNING] [" << module << "] " << message << std::endl;
+Logger::Logger() : isWoken(false), isStopping(false) {
+    thread = std::thread(runLogger, std::ref(*this));
 }
 
-void logInfo(const std::string& module, const std::string& message) {
-    std::cerr << "[INFO] [" << module << "] " << message << std::endl;
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        isStopping = true;
+    }
+    wakeUp.notify_one();
+    thread.join();
+}
+
+void pushLogRecord(const LogLevel level, const std::string_view module,
+    const std::string_view message, const std::initializer_list<LogField> fields) {
+    // A thread's first message sets up its ring, which is the only time
+    // logging takes a lock
+    if (threadLogRing.ring == nullptr) {
+        threadLogRing.ring = std::make_shared<LogRing>();
+        Logger& logger = getLogger();
+        std::lock_guard<std::mutex> lock(logger.ringsMutex);
+        logger.rings.push_back(threadLogRing.ring);
+    }
+    LogRing& ring = *threadLogRing.ring;
+
+    const u_int64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+        ring.numDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring.records[head % LOG_RING_SIZE];
+    record.time = std::chrono::steady_clock::now().time_since_epoch().count();
+    record.level = level;
+    record.moduleLength = static_cast<u_int32_t>(module.size());
+    record.messageLength = static_cast<u_int32_t>(message.size());
+    record.numFields = std::min(static_cast<int>(fields.size()), MAX_LOG_FIELDS);
+    std::copy_n(fields.begin(), record.numFields, record.fields);
+
+    const size_t textLength = module.size() + message.size();
+    record.longText = textLength > LOG_INLINE_TEXT_SIZE ? new char[textLength] : nullptr;
+    char* text = record.longText == nullptr ? record.text : record.longText;
+    std::memcpy(text, module.data(), module.size());
+    std::memcpy(text + module.size(), message.data(), message.size());
+
+    ring.head.store(head + 1, std::memory_order_release);
+
+    // Warnings and errors are worth seeing right away
+    if (level >= LOG_WARNING) {
+        Logger& logger = getLogger();
+        logger.isWoken.store(true);
+        logger.wakeUp.notify_one();
+    }
 }
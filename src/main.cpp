@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <cmath>
+#include <future>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -12,24 +15,130 @@
 #include <madoc/log_utils.h>
 #include <madoc/voronoi.h>
 #include <madoc/voronoi_mesh.h>
+#include <madoc/vertex_format.h>
+#include <madoc/cell_attributes.h>
+#include <madoc/mesh_optimizer.h>
+#include <madoc/contour_simplification.h>
+#include <madoc/camera.h>
+#include <madoc/world_mesh.h>
+#include <madoc/delaunay.h>
+#include <madoc/cell_graph.h>
+#include <madoc/hydrology.h>
+#include <madoc/climate.h>
+#include <madoc/regions.h>
+#include <madoc/borders.h>
+#include <madoc/task_scheduler.h>
+#include <madoc/generation_server.h>
+#include <madoc/world_generator.h>
+#include <madoc/terrain_editor.h>
 #include "madoc/biome_generator.h"
 #include "madoc/perlin_noise.h"
 
 
-void generateWorld(int seed);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void scroll_callback(GLFWwindow* window, double xOffset, double yOffset);
+glm::vec2 getCursorWorldPosition(GLFWwindow* window);
 void processInput(GLFWwindow *window);
 
-bool isWireframe = false;
+bool showBorders = true;
+std::array<bool, NUM_BORDER_TYPES> visibleBorderTypes = {true, true, true, true};
+Camera camera;
+double deltaTime = 0.0;
+bool isCyclingSeeds = true;
+// Left click raises, lowers or paints with the brush, and right click picks
+// the biome under the cursor to paint with
+Brush brush = {RAISE_BRUSH, 15.0f, 0.5f, 0};
+bool isBrushDown = false;
+bool isPickingBiome = false;
+glm::vec2 cursorPosition = {0.0f, 0.0f};
+bool isPrintingViewStats = false;
+
+
+int main(int argc, char* argv[]) {
+    // With --server, worlds are generated for other programs over stdin and
+    // stdout (or the Unix socket named after it) instead of being shown
+    const bool isServer = argc > 1 && std::string(argv[1]) == "--server";
+    if (isServer) {
+        // stdout carries the responses, so everything else printed goes to stderr
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    logInfo("main", "Start of main");
 
+    // BIOMES
+    BiomeTable biomeTable;
+    try {
+        biomeTable = loadBiomeTable("assets/data/biomes.txt");
+    }
+    catch (const std::runtime_error& error) {
+        logError("biome_generator", error.what());
+        return -1;
+    }
+
+
+    // WORLD GENERATION
+    int seed = 99342094;
+    WorldSettings settings;
+    settings.width = 1000;
+    settings.height = 600;
 
-int main() {
-    std::cout << "Start of main\n";
+    // VORONOI STUFF
+    settings.macroWidth = 20;
+    settings.macroHeight = 12;
+    settings.minPoints = 2;
+    settings.maxPoints = 2;
+    // Poisson disk sampling spaces the feature points out evenly, at least
+    // this many grid units apart, instead of placing them randomly
+    settings.usePoissonDisk = true;
+    settings.poissonDistance = 10.0f;
+    // Rounds of Lloyd relaxation, which even out the cells' shapes and sizes
+    settings.relaxIterations = settings.usePoissonDisk ? 2 : 4;
+    // The vector engine builds exact cell outlines straight from the feature
+    // points, instead of tracing each cell's bitmask on the grid
+    settings.useVectorCells = true;
+    // Shade the land by its slope, as if lit from the northwest
+    settings.useHillshading = true;
+    // Skip the rivers, regions, borders and query tables, which only the
+    // viewer uses (the generation server sets this)
+    settings.isMeshOnly = false;
+
+    // Layout of the vertex buffer; COMPACT_VERTEX is 3x smaller than FLOAT_VERTEX,
+    // and CELL_ID_VERTEX lets cells be recolored without touching the vertices
+    const VertexFormat vertexFormat = CELL_ID_VERTEX;
+    // How far (in grid units) simplified cell outlines may stray from the grid,
+    // for each level of detail from most to least detailed. Vector cells can't
+    // be simplified, so they only have one level before the raster one.
+    settings.lodTolerances = {1.0f, 4.0f};
+    // Size (in grid units) of the chunks the mesh is split into for culling
+    settings.chunkWidth = 128;
+    settings.chunkHeight = 128;
+    // Cells are turned into triangles this many at a time, split across
+    // threads this many at a time
+    settings.meshBatchSize = 4096;
+    settings.meshGrainSize = 64;
+    // How many provinces the land is split into, and how many nations those
+    // are grouped into
+    settings.numProvinces = 150;
+    settings.numNations = 12;
+    // How much rainfall has to flow through a cell before it's drawn as a
+    // river, where a grid cell of saturated air raining out completely is 1
+    settings.riverMinFlow = 6.0f;
+
+    // New seeds are shown as a coarse preview right away, while the full world
+    // is generated in the background. The preview's grid is this many times
+    // coarser each way, and its cells are this far apart on it (twice as wide
+    // as the full world's cells).
+    const bool useProgressiveGeneration = true;
+    settings.previewScale = 5;
+    settings.previewPoissonDistance = 4.0f;
+
+    if (isServer) {
+        return runGenerationServer(settings, biomeTable, argc > 2 ? argv[2] : "");
+    }
 
     // BOILERPLATE NONSENSE
     if (!glfwInit()) {
-        std::cerr << "GLFW failed to initialize!" << std::endl;
+        logError("main", "GLFW failed to initialize!");
     }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
@@ -45,7 +154,7 @@ int main() {
         glfwGetPrimaryMonitor(), nullptr);
     if (window == nullptr)
     {
-        std::cout << "Failed to create GLFW window!" << std::endl;
+        logError("main", "Failed to create GLFW window!");
         glfwTerminate();
         return -1;
     }
@@ -53,188 +162,306 @@ int main() {
     glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetScrollCallback(window, scroll_callback);
 
     // Load GLAD and set the viewport
     if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
     {
-        std::cout << "Failed to initialize GLAD!" << std::endl;
+        logError("main", "Failed to initialize GLAD!");
         return -1;
     }
     glViewport(0, 0, screenWidth, screenHeight);
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
 
-    std::cout << "GLFW boilerplate complete\n";
+    logInfo("main", "GLFW boilerplate complete");
 
     // SHADERS
-    // Load shader files
-    std::string vertex;
-    std::string fragment;
+    // The shaders are built into the program. Point this at a directory (like
+    // "assets/shaders") to load them from there instead while editing them.
+    const std::string shaderOverrideDirectory = "";
+    // The linked program is cached here, so later launches don't compile it
+    const std::string shaderCachePath = "shader_program.cache";
+    // Set up the shader program
+    GLuint shaderProgram;
     try {
-        vertex = readShaderFile("assets/shaders/vertex.glsl");
-        fragment = readShaderFile("assets/shaders/fragment.glsl");
+        shaderProgram = loadShaderProgram(
+            getShaderSource("vertex.glsl", shaderOverrideDirectory),
+            getShaderSource("fragment.glsl", shaderOverrideDirectory), shaderCachePath);
     }
     catch (const std::runtime_error& error) {
         logError("shader_utils", error.what());
         return -1;
     }
-    const char* vertexShaderSource = vertex.c_str();
-    const char* fragmentShaderSource = fragment.c_str();
-    // Set up the shader program
-    GLuint shaderProgram;
+
+    const ShaderUniforms uniforms = getShaderUniforms(shaderProgram);
+
+    logInfo("shader_utils", "Shader complete");
+
+    World world;
     try {
-        const GLuint vertexShader = createShader(vertexShaderSource, VERTEX);
-        const GLuint fragmentShader = createShader(fragmentShaderSource, FRAGMENT);
-        GLuint shaderList[] = {vertexShader, fragmentShader};
-        shaderProgram = createShaderProgram(shaderList);
+        world = generateWorld(settings, biomeTable, seed);
     }
     catch (const std::runtime_error& error) {
-        logError("shader_utils", error.what());
+        logError("world_generator", error.what());
         return -1;
     }
+    MADOC_LOG(LOG_INFO, "world_generator", "World generation complete",
+        {"seed", seed}, {"threads", getNumWorkerThreads()});
+    MADOC_LOG(LOG_INFO, "mesh_optimizer", "Vertex cache optimization complete",
+        {"original_acmr", world.originalACMR}, {"acmr", world.optimizedACMR},
+        {"original_atvr", world.originalATVR}, {"atvr", world.optimizedATVR});
+    MADOC_LOG(LOG_INFO, "hydrology", "Hydrology complete",
+        {"river_segments", world.riverVertices.size() / 12});
+    MADOC_LOG(LOG_INFO, "regions", "Regions complete",
+        {"provinces", world.provinces.numRegions}, {"nations", world.nations.numRegions});
+    MADOC_LOG(LOG_INFO, "borders", "Borders complete",
+        {"segments", world.borderSegments.size()});
 
-    std::cout << "Shader complete\n";
 
+    // BUFFERS AND SUCH
+    GLuint VBO, EBO, VAO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
 
-    // WORLD GENERATION
-    int width = 1000;
-    int height = 600;
-    int seed = 99342094;
+    // Rivers are a separate line mesh, always in the float vertex format
+    GLuint riverVBO, riverVAO;
+    glGenVertexArrays(1, &riverVAO);
+    glGenBuffers(1, &riverVBO);
 
-    // VORONOI STUFF
-    const int macroWidth = 20;
-    const int macroHeight = 12;
-    const int minPoints = 2;
-    const int maxPoints = 2;
-    VoronoiGrid grid = createVoronoiGrid(width, height, macroWidth, macroHeight);
-    generateVoronoiCells(grid, seed, minPoints, maxPoints);
+    // And so are the borders
+    GLuint borderVBO, borderVAO;
+    glGenVertexArrays(1, &borderVAO);
+    glGenBuffers(1, &borderVBO);
 
-    // Get a list of all bitmasks
-    std::vector<VoronoiBitmask> bitmasks;
-    bitmasks.reserve(grid.numFeaturePoints);
-    for (int i  = 0; i < grid.numFeaturePoints; i++) {
-        VoronoiBitmask currentBitmask = generateVoronoiBitmask(grid, i);
-        bitmasks.push_back(currentBitmask);
-    }
-    std::cout << "Bitmask data complete\n";
+    // The cell colors are always uploaded, but only read by CELL_ID_VERTEX
+    CellAttributeBuffer cellAttributes = createCellAttributeBuffer(world.cellColors);
 
+    // Cells edited by the brush are uploaded once per frame. The other
+    // formats bake colors into the vertices, so they need to know where each
+    // cell's vertices are.
+    DirtyCells dirtyCells;
+    CellVertexMap cellVertices;
 
-    // VERTEX DATA
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    unsigned int numPreviousIndices = 0;
-
-    // For each bitmask, get the vertex and index data for that polygon
-    for (int i = 0; i < bitmasks.size(); i++) {
-        VoronoiBitmask& currentBitmask = bitmasks[i];
-        std::vector<float> currentVertices = getEdgeVertices(currentBitmask);
-        std::vector<unsigned int> currentIndices = getEarClippedIndices(currentVertices);
-        if (numPreviousIndices != 0) {
-            for (int j = 0; j < currentIndices.size(); j++) {
-                currentIndices[j] += numPreviousIndices;
-            }
+    // Puts a whole world on the GPU, replacing whatever was there
+    auto uploadWorld = [&](const World& newWorld) {
+        glBindVertexArray(VAO);
+        uploadWorldMesh(newWorld.mesh, vertexFormat, VBO, EBO);
+        glBindVertexArray(riverVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, riverVBO);
+        glBufferData(GL_ARRAY_BUFFER, newWorld.riverVertices.size() * sizeof(float),
+            newWorld.riverVertices.data(), GL_DYNAMIC_DRAW);
+        glBindVertexArray(borderVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, borderVBO);
+        glBufferData(GL_ARRAY_BUFFER, newWorld.borderMesh.vertices.size() * sizeof(float),
+            newWorld.borderMesh.vertices.data(), GL_DYNAMIC_DRAW);
+
+        // Worlds don't all have the same number of cells
+        if (newWorld.grid.numFeaturePoints != cellAttributes.numCells) {
+            deleteCellAttributeBuffer(cellAttributes);
+            cellAttributes = createCellAttributeBuffer(newWorld.cellColors);
         }
-        numPreviousIndices += currentVertices.size() / 3;
-
-        // Get the centroid coordinate of each polygon, and plug it into the
-        // Perlin noise function to get its color value
-        std::vector<float> centroid = getCenterVertex(currentVertices);
-        std::vector<float> currentColor = generateBiomeColor(centroid[0], centroid[1], seed);
+        else {
+            updateCellColors(cellAttributes, newWorld.cellColors, 0, cellAttributes.numCells);
+        }
+        glUseProgram(shaderProgram);
+        bindCellAttributeBuffer(cellAttributes, uniforms.cellColors, 0);
 
-        // Add the generated color value to the list of vertex data
-        for (int j = 3; j < currentVertices.size(); j += 6) {
-            currentVertices.insert(currentVertices.begin() + j, currentColor[0]);
-            currentVertices.insert(currentVertices.begin() + j + 1, currentColor[1]);
-            currentVertices.insert(currentVertices.begin() + j + 2, currentColor[2]);
+        dirtyCells = createDirtyCells(newWorld.grid.numFeaturePoints);
+        if (vertexFormat != CELL_ID_VERTEX) {
+            cellVertices = createCellVertexMap(newWorld.mesh, newWorld.grid.numFeaturePoints);
         }
-        currentVertices.insert(currentVertices.end(), currentColor[0]);
-        currentVertices.insert(currentVertices.end(), currentColor[1]);
-        currentVertices.insert(currentVertices.end(), currentColor[2]);
+    };
 
-        vertices.insert(vertices.end(), currentVertices.begin(), currentVertices.end());
-        indices.insert(indices.end(), currentIndices.begin(), currentIndices.end());
+    try {
+        uploadWorld(world);
     }
-    std::cout << "Vertex data complete\n";
-
-
-    // BUFFERS AND SUCH
-    GLuint VBO, EBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    catch (const std::runtime_error& error) {
+        logError("vertex_format", error.what());
+        return -1;
+    }
+    MADOC_LOG(LOG_INFO, "vertex_format", "Vertex buffer uploaded",
+        {"bytes", (world.mesh.vertices.size() / 6) * getVertexStride(vertexFormat)},
+        {"chunks", world.mesh.chunks.size()});
 
     glBindVertexArray(VAO);
-
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, (vertices.size() * sizeof(float)),
-        vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (indices.size() * sizeof(unsigned int)),
-        indices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-        static_cast<void *>(nullptr));
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-        reinterpret_cast<void *>(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glUseProgram(shaderProgram);
+    setVertexAttributes(vertexFormat);
+    glBindVertexArray(riverVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, riverVBO);
+    setVertexAttributes(FLOAT_VERTEX);
+    glBindVertexArray(borderVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, borderVBO);
+    setVertexAttributes(FLOAT_VERTEX);
+
+    camera = createCamera(settings.width, settings.height, screenWidth, screenHeight);
+    // Fitting the world on screen is often still too close for the coarser
+    // levels of detail, so let the camera zoom out past where the coarsest one
+    // takes over. The levels are in the mesh's grid units.
+    camera.minZoom = std::min(camera.minZoom,
+        getLodSwitchZoom(world.mesh, world.mesh.numLods - 1) / world.meshScale / 2.0f);
 
 
     // THE RENDER LOOP
-    std::cout << "Entering render loop\n\n";
+    logInfo("main", "Entering render loop");
 
     std::mt19937 seedGenerator(314159265);
     std::uniform_int_distribution<int> randomSeed(0, 999999999);
     double lastSeedTime = glfwGetTime();
     double seedInterval = 2.0f;
+    double lastFrameTime = glfwGetTime();
+    int lodLevel = 0;
+    // The full world being generated in the background, if there is one
+    std::future<World> pendingWorld;
+    // Whether the brush has changed the world since its tables were built
+    bool areTablesStale = false;
+    auto generationStart = std::chrono::high_resolution_clock::now();
 
     while(!glfwWindowShouldClose(window))
     {
-        processInput(window);
         double currentTime = glfwGetTime();
+        deltaTime = currentTime - lastFrameTime;
+        lastFrameTime = currentTime;
+        processInput(window);
 
-        // Generate a new world every few seconds
-        if (currentTime - lastSeedTime >= seedInterval) {
+        // Generate a new world every few seconds, once the last one is done
+        if (isCyclingSeeds && currentTime - lastSeedTime >= seedInterval &&
+            !pendingWorld.valid()) {
             seed = randomSeed(seedGenerator);
-            std::cout << "Current Seed: " << seed << "\n";
+            MADOC_LOG(LOG_INFO, "main", "Generating a new world", {"seed", seed});
+
+            generationStart = std::chrono::high_resolution_clock::now();
+            try {
+                if (useProgressiveGeneration) {
+                    // Show the preview now, and refine it in the background
+                    world = generatePreviewWorld(settings, biomeTable, seed);
+                    uploadWorld(world);
+                    std::chrono::duration<double> diff =
+                        std::chrono::high_resolution_clock::now() - generationStart;
+                    MADOC_LOG(LOG_INFO, "world_generator", "Preview complete",
+                        {"seed", seed}, {"elapsed", diff});
+
+                    pendingWorld = std::async(std::launch::async,
+                        [&settings, &biomeTable, seed]() {
+                            return generateWorld(settings, biomeTable, seed);
+                        });
+                }
+                else {
+                    world = generateWorld(settings, biomeTable, seed);
+                    uploadWorld(world);
+                    std::chrono::duration<double> diff =
+                        std::chrono::high_resolution_clock::now() - generationStart;
+                    MADOC_LOG(LOG_INFO, "world_generator", "Generation complete",
+                        {"seed", seed}, {"elapsed", diff});
+                }
+            }
+            catch (const std::runtime_error& error) {
+                logError("world_generator", error.what());
+                glfwSetWindowShouldClose(window, true);
+            }
 
-            auto start = std::chrono::high_resolution_clock::now();
+            lastSeedTime = currentTime;
+        }
 
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> diff = end - start;
-            std::cout << "Generation took " << diff << "\n\n";
+        // Swap the full world in for the preview as soon as it's done
+        if (pendingWorld.valid() &&
+            pendingWorld.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            try {
+                world = pendingWorld.get();
+                uploadWorld(world);
+                std::chrono::duration<double> diff =
+                    std::chrono::high_resolution_clock::now() - generationStart;
+                MADOC_LOG(LOG_INFO, "world_generator", "Generation complete",
+                    {"seed", world.seed}, {"elapsed", diff});
+            }
+            catch (const std::runtime_error& error) {
+                logError("world_generator", error.what());
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
 
-            lastSeedTime = currentTime;
+        // Edit the full world under the cursor (a preview is about to be
+        // replaced anyway), and stop cycling seeds so the edits stay
+        if ((isBrushDown || isPickingBiome) && !pendingWorld.valid()) {
+            isCyclingSeeds = false;
+            if (isPickingBiome) {
+                const int cell = getCellAtPosition(world.grid, world.meshScale, cursorPosition);
+                if (cell != -1) {
+                    brush.mode = PAINT_BRUSH;
+                    brush.biome = world.cellBiomes[cell];
+                }
+            }
+            else {
+                applyBrush(world, biomeTable, brush, cursorPosition,
+                    static_cast<float>(deltaTime), dirtyCells);
+                areTablesStale = true;
+            }
+        }
+        // The tables are rebuilt once a stroke is done, not every frame of it
+        if (areTablesStale && !isBrushDown) {
+            world.tables = createSummedAreaTables(world.grid, world.meshScale,
+                world.cellElevations, world.cellBiomes,
+                static_cast<int>(biomeTable.biomes.size()), biomeTable.seaLevel);
+            areTablesStale = false;
+        }
+        try {
+            uploadDirtyCells(world, biomeTable, cellVertices, cellAttributes, vertexFormat, VBO,
+                borderVBO, dirtyCells);
+        }
+        catch (const std::runtime_error& error) {
+            logError("terrain_editor", error.what());
+            glfwSetWindowShouldClose(window, true);
         }
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Set projection matrices
-        glm::mat4 model         = glm::mat4(1.0f);
-        glm::mat4 view          = glm::mat4(1.0f);
-        glm::mat4 projection    = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, -20.0f));
-        model = glm::scale(model, glm::vec3(1.0f));
-        view = glm::translate(glm::mat4(1.0f), glm::vec3(-width / 2, height / 2, -750.0f));
-        projection = glm::perspective(glm::radians(45.0f),
-            static_cast<float>(screenWidth) / static_cast<float>(screenHeight), 0.1f, 1000.0f);
+        // Set projection matrices. A preview's mesh is in coarse grid units,
+        // so the model matrix scales it up to the world.
+        glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
+        glm::mat4 model = glm::scale(glm::mat4(1.0f),
+            glm::vec3(world.meshScale, world.meshScale, 1.0f));
+        glm::mat4 view = getViewMatrix(camera);
+        glm::mat4 projection = getProjectionMatrix(camera, screenWidth, screenHeight);
 
         // Use shader uniforms
         glUseProgram(shaderProgram);
-        GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-        GLuint viewLoc  = glGetUniformLocation(shaderProgram, "view");
-        GLuint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Draw stuff on screen
+        glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+        glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+
+        // Draw only the chunks that are on screen
+        glm::vec2 viewMin, viewMax;
+        getCameraBounds(camera, screenWidth, screenHeight, viewMin, viewMax);
+
+        // Summarize what's on screen
+        if (isPrintingViewStats) {
+            const GridRect viewRect = getGridRect(world.tables, viewMin, viewMax);
+            const std::vector<int> histogram = getBiomeHistogram(world.tables, viewRect);
+            const int commonBiome = static_cast<int>(
+                std::max_element(histogram.begin(), histogram.end()) - histogram.begin());
+            MADOC_LOG(LOG_INFO, "world_queries",
+                "On screen, mostly " + biomeTable.biomes[commonBiome].name,
+                {"land_percent", getLandFraction(world.tables, viewRect) * 100.0f},
+                {"mean_elevation", getMeanElevation(world.tables, viewRect)});
+            isPrintingViewStats = false;
+        }
+        std::vector<int> visibleChunks = getVisibleChunks(world.mesh, viewMin / world.meshScale,
+            viewMax / world.meshScale);
+        // Draw them at the coarsest level of detail that still looks right
+        lodLevel = selectLod(world.mesh, lodLevel, camera.zoom * world.meshScale);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        drawWorldMesh(world.mesh, visibleChunks, lodLevel, vertexFormat, uniforms);
+
+        // Draw the borders and rivers on top, which are always in world space
+        glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+        setVertexFormatUniforms(uniforms, FLOAT_VERTEX, glm::vec2(0.0f));
+        if (showBorders) {
+            glBindVertexArray(borderVAO);
+            drawBorderMesh(world.borderMesh, visibleBorderTypes, camera.zoom);
+        }
+        glBindVertexArray(riverVAO);
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(world.riverVertices.size() / 6));
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -243,6 +470,11 @@ int main() {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &riverVAO);
+    glDeleteBuffers(1, &riverVBO);
+    glDeleteVertexArrays(1, &borderVAO);
+    glDeleteBuffers(1, &borderVBO);
+    deleteCellAttributeBuffer(cellAttributes);
     glDeleteProgram(shaderProgram);
 
     glfwTerminate();
@@ -269,15 +501,64 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
-    // TAB to toggle wireframe mode
-    if (!isWireframe && key == GLFW_KEY_TAB && action == GLFW_PRESS) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        isWireframe = true;
+    // TAB to toggle the border overlay
+    if (key == GLFW_KEY_TAB && action == GLFW_PRESS) {
+        showBorders = !showBorders;
     }
-    else if (isWireframe && key == GLFW_KEY_TAB && action == GLFW_PRESS) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        isWireframe = false;
+    // 1-4 to toggle cell, province, nation and coast borders
+    if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + NUM_BORDER_TYPES && action == GLFW_PRESS) {
+        visibleBorderTypes[key - GLFW_KEY_1] = !visibleBorderTypes[key - GLFW_KEY_1];
+    }
+    // SPACE to pause or resume generating new seeds
+    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+        isCyclingSeeds = !isCyclingSeeds;
+    }
+    // I to print a summary of what's on screen
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        isPrintingViewStats = true;
+    }
+    // R/F/P to switch the brush to raising, lowering or painting
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        brush.mode = RAISE_BRUSH;
+    }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        brush.mode = LOWER_BRUSH;
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        brush.mode = PAINT_BRUSH;
+    }
+}
+
+/*
+ * Get the world space position under the cursor. GLFW gives the cursor in
+ * window coordinates, but the camera works in framebuffer pixels, and on high
+ * DPI displays there are more of those than window coordinates.
+ */
+glm::vec2 getCursorWorldPosition(GLFWwindow* window)
+{
+    int screenWidth, screenHeight, windowWidth, windowHeight;
+    double cursorX, cursorY;
+    glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    // A minimized window has no size to scale by
+    if (windowWidth == 0 || windowHeight == 0) {
+        return camera.position;
     }
+
+    const glm::vec2 pixelScale = {static_cast<float>(screenWidth) / windowWidth,
+        static_cast<float>(screenHeight) / windowHeight};
+    return screenToWorld(camera, screenWidth, screenHeight,
+        glm::vec2(static_cast<float>(cursorX), static_cast<float>(cursorY)) * pixelScale);
+}
+
+/*
+ * Zoom the camera in and out around the cursor with the scroll wheel
+ */
+void scroll_callback(GLFWwindow* window, double xOffset, double yOffset)
+{
+    zoomCamera(camera, std::pow(1.1f, static_cast<float>(yOffset)),
+        getCursorWorldPosition(window));
 }
 
 /*
@@ -286,7 +567,36 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
  */
 void processInput(GLFWwindow *window)
 {
+    // WASD/arrow keys to pan at a constant speed on screen
+    const float panSpeed = 800.0f * static_cast<float>(deltaTime);
+    glm::vec2 pan = {0.0f, 0.0f};
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+        pan.y += panSpeed;
+    }
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+        pan.y -= panSpeed;
+    }
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+        pan.x -= panSpeed;
+    }
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+        pan.x += panSpeed;
+    }
+    panCamera(camera, pan);
+
+    // E/Q to zoom in and out around the middle of the screen
+    const float zoomSpeed = std::pow(2.0f, static_cast<float>(deltaTime));
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+        zoomCamera(camera, zoomSpeed, camera.position);
+    }
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+        zoomCamera(camera, 1.0f / zoomSpeed, camera.position);
+    }
 
+    // Mouse buttons to use the brush where the cursor is
+    cursorPosition = getCursorWorldPosition(window);
+    isBrushDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    isPickingBiome = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
 }
 
 /*
@@ -0,0 +1,248 @@
+#include <cmath>
+#include <algorithm>
+
+#include <madoc/mesh_optimizer.h>
+
+
+// Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+/*
+ * Scores how much we want to use a vertex next, based on where it sits in the
+ * simulated cache and how many triangles still need it.
+ */
+float getVertexScore(const int cachePosition, const int remainingTriangles) {
+    // Nothing left to draw with this vertex
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The last triangle's vertices get a fixed score so we don't just keep
+        // drawing strips in one direction
+        if (cachePosition < 3) {
+            score = LAST_TRIANGLE_SCORE;
+        }
+        else {
+            const float scaler = 1.0f / static_cast<float>(VERTEX_CACHE_SIZE - 3);
+            score = 1.0f - (static_cast<float>(cachePosition - 3) * scaler);
+            score = std::pow(score, CACHE_DECAY_POWER);
+        }
+    }
+
+    // Boost vertices with few triangles left so they get finished off
+    score += VALENCE_BOOST_SCALE *
+        std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+
+    return score;
+}
+
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices,
+    const int numVertices) {
+    const int numTriangles = static_cast<int>(indices.size() / 3);
+    if (numTriangles == 0) {
+        return indices;
+    }
+
+    // Build the vertex -> triangle adjacency in a flat list
+    std::vector<int> remainingTriangles(numVertices, 0);
+    for (int i = 0; i < numTriangles * 3; i++) {
+        remainingTriangles[indices[i]]++;
+    }
+    std::vector<int> adjacencyOffsets(numVertices + 1, 0);
+    for (int i = 0; i < numVertices; i++) {
+        adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remainingTriangles[i];
+    }
+    std::vector<int> adjacency(adjacencyOffsets[numVertices]);
+    std::vector<int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (int i = 0; i < numTriangles * 3; i++) {
+        adjacency[adjacencyFill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<float> vertexScores(numVertices);
+    for (int i = 0; i < numVertices; i++) {
+        vertexScores[i] = getVertexScore(-1, remainingTriangles[i]);
+    }
+    std::vector<float> triangleScores(numTriangles);
+    for (int i = 0; i < numTriangles; i++) {
+        triangleScores[i] = vertexScores[indices[i * 3]] +
+            vertexScores[indices[(i * 3) + 1]] + vertexScores[indices[(i * 3) + 2]];
+    }
+    std::vector<bool> isEmitted(numTriangles, false);
+
+    // Each step pushes the triangle's 3 vertices onto the front of the cache,
+    // which can briefly hold 3 more than VERTEX_CACHE_SIZE before whatever
+    // was pushed past the end is evicted and it's trimmed back down
+    std::vector<int> cache;
+    std::vector<int> newCache;
+    std::vector<int> evicted;
+    cache.reserve(VERTEX_CACHE_SIZE + 3);
+    newCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+    std::vector<unsigned int> optimizedIndices;
+    optimizedIndices.reserve(indices.size());
+
+    int bestTriangle = -1;
+    int scanCursor = 0;
+    for (int emitted = 0; emitted < numTriangles; emitted++) {
+        // If nothing in the cache has triangles left, move on to the next
+        // unused triangle in the original order
+        if (bestTriangle < 0) {
+            while (isEmitted[scanCursor]) {
+                scanCursor++;
+            }
+            bestTriangle = scanCursor;
+        }
+
+        isEmitted[bestTriangle] = true;
+        newCache.clear();
+        for (int i = 0; i < 3; i++) {
+            const unsigned int vertex = indices[(bestTriangle * 3) + i];
+            optimizedIndices.push_back(vertex);
+            newCache.push_back(static_cast<int>(vertex));
+
+            // Take this triangle out of the vertex's list of remaining triangles
+            int* adjacencyStart = adjacency.data() + adjacencyOffsets[vertex];
+            int* adjacencyEnd = adjacencyStart + remainingTriangles[vertex];
+            int* triangleEntry = std::find(adjacencyStart, adjacencyEnd, bestTriangle);
+            if (triangleEntry != adjacencyEnd) {
+                std::iter_swap(triangleEntry, adjacencyEnd - 1);
+                remainingTriangles[vertex]--;
+            }
+        }
+        for (int i = 0; i < cache.size(); i++) {
+            if (std::find(newCache.begin(), newCache.end(), cache[i]) == newCache.end()) {
+                newCache.push_back(cache[i]);
+            }
+        }
+        // Anything pushed past the end of the cache is evicted
+        evicted.clear();
+        for (int i = VERTEX_CACHE_SIZE; i < newCache.size(); i++) {
+            evicted.push_back(newCache[i]);
+        }
+        if (newCache.size() > VERTEX_CACHE_SIZE) {
+            newCache.resize(VERTEX_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+
+        // Rescore everything in the cache, then the triangles they touch
+        for (int i = 0; i < cache.size(); i++) {
+            const int vertex = cache[i];
+            const float newScore = getVertexScore(i, remainingTriangles[vertex]);
+            const float scoreChange = newScore - vertexScores[vertex];
+            vertexScores[vertex] = newScore;
+            for (int j = 0; j < remainingTriangles[vertex]; j++) {
+                triangleScores[adjacency[adjacencyOffsets[vertex] + j]] += scoreChange;
+            }
+        }
+        for (int i = 0; i < evicted.size(); i++) {
+            const int vertex = evicted[i];
+            const float newScore = getVertexScore(-1, remainingTriangles[vertex]);
+            const float scoreChange = newScore - vertexScores[vertex];
+            vertexScores[vertex] = newScore;
+            for (int j = 0; j < remainingTriangles[vertex]; j++) {
+                triangleScores[adjacency[adjacencyOffsets[vertex] + j]] += scoreChange;
+            }
+        }
+
+        // The next triangle is the best one that uses a cached vertex
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cache.size(); i++) {
+            const int vertex = cache[i];
+            for (int j = 0; j < remainingTriangles[vertex]; j++) {
+                const int triangle = adjacency[adjacencyOffsets[vertex] + j];
+                if (triangleScores[triangle] > bestScore) {
+                    bestScore = triangleScores[triangle];
+                    bestTriangle = triangle;
+                }
+            }
+        }
+    }
+
+    return optimizedIndices;
+}
+
+std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices,
+    const int numVertices) {
+    const unsigned int unassigned = static_cast<unsigned int>(-1);
+    std::vector<unsigned int> remap(numVertices, unassigned);
+    unsigned int nextVertex = 0;
+
+    for (int i = 0; i < indices.size(); i++) {
+        if (remap[indices[i]] == unassigned) {
+            remap[indices[i]] = nextVertex;
+            nextVertex++;
+        }
+        indices[i] = remap[indices[i]];
+    }
+
+    // Keep unreferenced vertices around so the vertex count doesn't change
+    for (int i = 0; i < numVertices; i++) {
+        if (remap[i] == unassigned) {
+            remap[i] = nextVertex;
+            nextVertex++;
+        }
+    }
+
+    return remap;
+}
+
+/*
+ * Counts how many times the vertex shader would run for the index buffer,
+ * simulating a FIFO post-transform cache of the given size.
+ */
+int countVertexTransforms(const std::vector<unsigned int>& indices, const int cacheSize) {
+    std::vector<unsigned int> fifo(cacheSize);
+    int fifoSize = 0;
+    int fifoHead = 0;
+    int transforms = 0;
+
+    for (int i = 0; i < indices.size(); i++) {
+        bool isCached = false;
+        for (int j = 0; j < fifoSize; j++) {
+            if (fifo[j] == indices[i]) {
+                isCached = true;
+                break;
+            }
+        }
+        if (!isCached) {
+            fifo[fifoHead] = indices[i];
+            fifoHead = (fifoHead + 1) % cacheSize;
+            fifoSize = std::min(fifoSize + 1, cacheSize);
+            transforms++;
+        }
+    }
+
+    return transforms;
+}
+
+float getACMR(const std::vector<unsigned int>& indices, const int cacheSize) {
+    if (indices.size() < 3) {
+        return 0.0f;
+    }
+    return static_cast<float>(countVertexTransforms(indices, cacheSize)) /
+        static_cast<float>(indices.size() / 3);
+}
+
+float getATVR(const std::vector<unsigned int>& indices, const int numVertices,
+    const int cacheSize) {
+    std::vector<bool> isUsed(numVertices, false);
+    int numUsedVertices = 0;
+    for (int i = 0; i < indices.size(); i++) {
+        if (!isUsed[indices[i]]) {
+            isUsed[indices[i]] = true;
+            numUsedVertices++;
+        }
+    }
+    if (numUsedVertices == 0) {
+        return 0.0f;
+    }
+
+    return static_cast<float>(countVertexTransforms(indices, cacheSize)) /
+        static_cast<float>(numUsedVertices);
+}
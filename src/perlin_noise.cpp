@@ -1,22 +1,72 @@
 #include <algorithm>
 #include <cmath>
 #include <random>
+#include <utility>
 
 #include <madoc/perlin_noise.h>
 
-std::array<glm::vec2, 32> generateGradients() {
-    std::array<glm::vec2, 32> gradientVectors;
+// pi/2 split into the closest double and what's left over, so angles can be
+// brought down to within pi/4 of a multiple of it without losing precision
+constexpr double HALF_PI_HIGH = 1.5707963267948966;
+constexpr double HALF_PI_LOW = 6.123233995736766e-17;
 
-    // Generate a list of 32 gradient unit vectors for our perlin nosie
-    // These are all evenly spaced around a unit circle
-    for (int i = 0; i < 32; i++) {
-        float angle = ((2.0f * glm::pi<float>()) / 32.0f) * i;
-        gradientVectors[i] = {cos(angle), sin(angle)};
+// Taylor series that are exact to a double for angles within pi/4 of zero
+static constexpr double getTaylorSine(const double angle) {
+    double term = angle;
+    double sum = angle;
+    for (int n = 1; n < 12; n++) {
+        term *= -(angle * angle) / ((2.0 * n) * ((2.0 * n) + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+static constexpr double getTaylorCosine(const double angle) {
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 12; n++) {
+        term *= -(angle * angle) / (((2.0 * n) - 1.0) * (2.0 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+// The unit vector at a non-negative angle, worked out at compile time
+static constexpr glm::vec2 getUnitVector(const double angle) {
+    const int quadrant = static_cast<int>((angle / HALF_PI_HIGH) + 0.5);
+    const double offset = (angle - (quadrant * HALF_PI_HIGH)) - (quadrant * HALF_PI_LOW);
+    const double cosine = getTaylorCosine(offset);
+    const double sine = getTaylorSine(offset);
+    switch (quadrant % 4) {
+        case 0:
+            return {static_cast<float>(cosine), static_cast<float>(sine)};
+        case 1:
+            return {static_cast<float>(-sine), static_cast<float>(cosine)};
+        case 2:
+            return {static_cast<float>(-cosine), static_cast<float>(-sine)};
+        default:
+            return {static_cast<float>(sine), static_cast<float>(-cosine)};
     }
+}
 
+// 32 gradient unit vectors for our perlin noise, evenly spaced around a unit
+// circle. The angles are the same floats they always were, so every vector
+// comes out exactly like cos() and sin() would make it.
+static constexpr std::array<glm::vec2, 32> createGradientVectors() {
+    std::array<glm::vec2, 32> gradientVectors = {};
+    for (int i = 0; i < 32; i++) {
+        const float angle = ((2.0f * glm::pi<float>()) / 32.0f) * i;
+        gradientVectors[i] = getUnitVector(angle);
+    }
     return gradientVectors;
 }
 
+constexpr std::array<glm::vec2, 32> GRADIENT_VECTORS = createGradientVectors();
+
+std::array<glm::vec2, 32> generateGradients() {
+    return GRADIENT_VECTORS;
+}
+
 std::array<int, 512> generatePermutationTable(int seed) {
     std::array<int, 512> permutationTable;
 
@@ -33,7 +83,8 @@ std::array<int, 512> generatePermutationTable(int seed) {
     return permutationTable;
 }
 
-float dotGridGradient(std::array<int, 512>& permutationTable, std::array<glm::vec2, 32>& gradientVectors,
+float dotGridGradient(const std::array<int, 512>& permutationTable,
+                      const std::array<glm::vec2, 32>& gradientVectors,
                       float xSample, float zSample, int xCorner, int zCorner) {
     // Hash the corner coordinates
     // NOTE: the '&' isn't some kind of reference; it's a faster % operation
@@ -48,12 +99,16 @@ float fade(float t) {
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
+float fadeDerivative(float t) {
+    return 30 * t * t * (t * (t - 2) + 1);
+}
+
 float lerp(float a, float b, float t) {
     return a + t * (b - a);
 }
 
-float samplePerlin(std::array<int, 512>& permutationTable,
-                   std::array<glm::vec2, 32>& gradientVectors, float x, float z) {
+float samplePerlin(const std::array<int, 512>& permutationTable,
+                   const std::array<glm::vec2, 32>& gradientVectors, float x, float z) {
     // Get the bottom left corner of the cell that the sampled point is in
     int xCell = static_cast<int>(std::floor(x));
     int zCell = static_cast<int>(std::floor(z));
@@ -89,10 +144,179 @@ float samplePerlin(std::array<int, 512>& permutationTable,
     return finalInfluence; // NOTE: This is a value between -1 and 1
 }
 
-float samplePerlinOctaves(std::array<int, 512>& permutationTable,
-                          std::array<glm::vec2, 32>& gradientVectors, float x,
+// The gradient vector that dotGridGradient() hashes a corner to
+static glm::vec2 getCornerGradient(const std::array<int, 512>& permutationTable,
+                                   const std::array<glm::vec2, 32>& gradientVectors,
+                                   int xCorner, int zCorner) {
+    return gradientVectors[permutationTable[(permutationTable[xCorner] + zCorner) & 255] % 32];
+}
+
+glm::vec3 samplePerlinWithDerivative(const std::array<int, 512>& permutationTable,
+                                     const std::array<glm::vec2, 32>& gradientVectors,
+                                     float x, float z) {
+    // Same cell, corners and hashing as samplePerlin()
+    int xCell = static_cast<int>(std::floor(x));
+    int zCell = static_cast<int>(std::floor(z));
+    float xSample = x - static_cast<float>(xCell);
+    float zSample = z - static_cast<float>(zCell);
+    int x0 = xCell & 255;
+    int x1 = (xCell + 1) & 255;
+    int z0 = zCell * 255;
+    int z1 = (zCell + 1) * 255;
+    glm::vec2 x0z0Gradient = getCornerGradient(permutationTable, gradientVectors, x0, z0);
+    glm::vec2 x1z0Gradient = getCornerGradient(permutationTable, gradientVectors, x1, z0);
+    glm::vec2 x0z1Gradient = getCornerGradient(permutationTable, gradientVectors, x0, z1);
+    glm::vec2 x1z1Gradient = getCornerGradient(permutationTable, gradientVectors, x1, z1);
+
+    float xFade = fade(xSample);
+    float zFade = fade(zSample);
+
+    // Each corner's influence is a plane, so its derivative is just its
+    // gradient vector
+    float x0z0Influence = x0z0Gradient.x * xSample + x0z0Gradient.y * zSample;
+    float x1z0Influence = x1z0Gradient.x * (xSample - 1) + x1z0Gradient.y * zSample;
+    float x0z1Influence = x0z1Gradient.x * xSample + x0z1Gradient.y * (zSample - 1);
+    float x1z1Influence = x1z1Gradient.x * (xSample - 1) + x1z1Gradient.y * (zSample - 1);
+
+    float z0Influence = lerp(x0z0Influence, x1z0Influence, xFade);
+    float z1Influence = lerp(x0z1Influence, x1z1Influence, xFade);
+    float finalInfluence = lerp(z0Influence, z1Influence, zFade);
+
+    // Product rule through both lerps, where the fades are the only other
+    // thing that changes along their own axis
+    glm::vec2 z0Derivative = x0z0Gradient + xFade * (x1z0Gradient - x0z0Gradient);
+    z0Derivative.x += fadeDerivative(xSample) * (x1z0Influence - x0z0Influence);
+    glm::vec2 z1Derivative = x0z1Gradient + xFade * (x1z1Gradient - x0z1Gradient);
+    z1Derivative.x += fadeDerivative(xSample) * (x1z1Influence - x0z1Influence);
+    glm::vec2 finalDerivative = z0Derivative + zFade * (z1Derivative - z0Derivative);
+    finalDerivative.y += fadeDerivative(zSample) * (z1Influence - z0Influence);
+
+    return {finalInfluence, finalDerivative.x, finalDerivative.y};
+}
+
+// The amplitude and frequency of every octave, and the sum of the amplitudes
+// that the octaves are normalized by
+template <int Octaves>
+struct OctaveTable {
+    std::array<float, Octaves> amplitudes;
+    std::array<float, Octaves> frequencies;
+    float amplitudeSum;
+};
+
+// Steps through the octaves exactly like the loop in samplePerlinOctaves()
+// does, so the unrolled kernels give the same floats
+template <int Octaves>
+static constexpr OctaveTable<Octaves> getOctaveTable(float amplitude, float frequency,
+                                                     const float persistence,
+                                                     const float lacunarity) {
+    OctaveTable<Octaves> table = {};
+    for (int i = 0; i < Octaves; i++) {
+        table.amplitudes[i] = amplitude;
+        table.frequencies[i] = frequency;
+        table.amplitudeSum += amplitude;
+        amplitude *= persistence;
+        frequency *= lacunarity;
+    }
+    return table;
+}
+
+// Adds up the octaves in order, fully unrolled
+template <int Octaves>
+static float sumOctaves(const std::array<int, 512>& permutationTable,
+                        const std::array<glm::vec2, 32>& gradientVectors, const float x,
+                        const float z, const OctaveTable<Octaves>& table) {
+    float finalSample = 0.0f;
+    [&]<size_t... octave>(std::index_sequence<octave...>) {
+        ((finalSample += samplePerlin(permutationTable, gradientVectors,
+                                      x * table.frequencies[octave],
+                                      z * table.frequencies[octave]) *
+                         table.amplitudes[octave]), ...);
+    }(std::make_index_sequence<Octaves>());
+
+    return finalSample / table.amplitudeSum;
+}
+
+template <OctaveSettings settings>
+float samplePerlinOctaves(const std::array<int, 512>& permutationTable, float x, float z) {
+    static constexpr OctaveTable<settings.octaves> table = getOctaveTable<settings.octaves>(
+        settings.amplitude, settings.frequency, settings.persistence, settings.lacunarity);
+    return sumOctaves(permutationTable, GRADIENT_VECTORS, x, z, table);
+}
+
+template float samplePerlinOctaves<ELEVATION_OCTAVES>(const std::array<int, 512>&, float, float);
+
+template <OctaveSettings settings>
+glm::vec3 samplePerlinOctavesWithDerivative(const std::array<int, 512>& permutationTable,
+                                            float x, float z) {
+    static constexpr OctaveTable<settings.octaves> table = getOctaveTable<settings.octaves>(
+        settings.amplitude, settings.frequency, settings.persistence, settings.lacunarity);
+
+    // The value adds up exactly like sumOctaves() does it. Each octave is the
+    // noise at frequency times the position, so its derivative gets
+    // multiplied by the frequency too.
+    float finalSample = 0.0f;
+    glm::vec2 finalDerivative = {0.0f, 0.0f};
+    auto addOctave = [&](const int octave) {
+        glm::vec3 perlinSample = samplePerlinWithDerivative(permutationTable, GRADIENT_VECTORS,
+            x * table.frequencies[octave], z * table.frequencies[octave]);
+        finalSample += perlinSample.x * table.amplitudes[octave];
+        finalDerivative += glm::vec2(perlinSample.y, perlinSample.z) *
+            (table.amplitudes[octave] * table.frequencies[octave]);
+    };
+    [&]<size_t... octave>(std::index_sequence<octave...>) {
+        (addOctave(octave), ...);
+    }(std::make_index_sequence<settings.octaves>());
+
+    return {finalSample / table.amplitudeSum, finalDerivative / table.amplitudeSum};
+}
+
+template glm::vec3 samplePerlinOctavesWithDerivative<ELEVATION_OCTAVES>(
+    const std::array<int, 512>&, float, float);
+
+template <int Octaves>
+static float sampleUnrolledOctaves(const std::array<int, 512>& permutationTable,
+                                   const std::array<glm::vec2, 32>& gradientVectors,
+                                   const float x, const float z, const float amplitude,
+                                   const float frequency, const float persistence,
+                                   const float lacunarity) {
+    return sumOctaves(permutationTable, gradientVectors, x, z,
+                      getOctaveTable<Octaves>(amplitude, frequency, persistence, lacunarity));
+}
+
+float samplePerlinOctaves(const std::array<int, 512>& permutationTable,
+                          const std::array<glm::vec2, 32>& gradientVectors, float x,
                           float z, int octaves, float amplitude, float frequency,
                           float persistence, float lacunarity) {
+    // Common octave counts get their own unrolled kernel
+    switch (octaves) {
+        case 1:
+            return sampleUnrolledOctaves<1>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 2:
+            return sampleUnrolledOctaves<2>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 3:
+            return sampleUnrolledOctaves<3>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 4:
+            return sampleUnrolledOctaves<4>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 5:
+            return sampleUnrolledOctaves<5>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 6:
+            return sampleUnrolledOctaves<6>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 7:
+            return sampleUnrolledOctaves<7>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        case 8:
+            return sampleUnrolledOctaves<8>(permutationTable, gradientVectors, x, z, amplitude,
+                                            frequency, persistence, lacunarity);
+        default:
+            break;
+    }
+
     float finalAmplitude = 0.0f;
     float finalSample = 0.0f;
 
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <random>
+
+#include <madoc/biome_generator.h>
+#include <madoc/regions.h>
+#include <madoc/task_scheduler.h>
+
+
+// A cell's distance from its region's seed and the region's ID packed into
+// one number, so the cheapest region (and the lower ID on a tie) is just the
+// smaller key. Non-negative floats keep their order as unsigned integers.
+static u_int64_t packRegionKey(const float distance, const int region) {
+    return (static_cast<u_int64_t>(std::bit_cast<u_int32_t>(distance)) << 32) |
+        static_cast<u_int32_t>(region);
+}
+
+static float getKeyDistance(const u_int64_t key) {
+    return std::bit_cast<float>(static_cast<u_int32_t>(key >> 32));
+}
+
+static int getKeyRegion(const u_int64_t key) {
+    return static_cast<int>(key & 0xFFFFFFFF);
+}
+
+constexpr u_int64_t UNREACHED_KEY = std::numeric_limits<u_int64_t>::max();
+
+// Active cells are relaxed in parallel in chunks of this many
+constexpr int RELAX_GRAIN_SIZE = 512;
+
+std::vector<float> getTerrainCosts(const std::vector<float>& elevation,
+    const BiomeTable& biomeTable) {
+    std::vector<float> costs(elevation.size());
+
+    for (int i = 0; i < elevation.size(); i++) {
+        if (elevation[i] < biomeTable.seaLevel) {
+            costs[i] = SEA_TERRAIN_COST;
+        }
+        else if (elevation[i] >= biomeTable.impassableLevel) {
+            costs[i] = IMPASSABLE_TERRAIN_COST;
+        }
+        else if (elevation[i] >= biomeTable.mountainLevel) {
+            costs[i] = MOUNTAIN_TERRAIN_COST;
+        }
+        else {
+            costs[i] = 1.0f;
+        }
+    }
+
+    return costs;
+}
+
+// Picks the seed cells in a random order, skipping cells too few steps away
+// from a seed that's already picked so the regions start out spread evenly.
+// If that runs out of cells, the rest are picked without spacing.
+static std::vector<int> pickSeedCells(const CellGraph& graph,
+    const std::vector<bool>& isClaimable, const int numRegions, const int seed) {
+    std::vector<int> candidates;
+    for (int i = 0; i < graph.numCells; i++) {
+        if (isClaimable[i]) {
+            candidates.push_back(i);
+        }
+    }
+    std::mt19937 generator(seed);
+    for (int i = static_cast<int>(candidates.size()) - 1; i > 0; i--) {
+        std::uniform_int_distribution<int> index(0, i);
+        std::swap(candidates[i], candidates[index(generator)]);
+    }
+
+    // Roughly half the number of steps across an average region
+    const float cellsPerRegion = static_cast<float>(candidates.size()) /
+        static_cast<float>(std::max(numRegions, 1));
+    const int spacing = static_cast<int>(std::sqrt(cellsPerRegion) / 2.0f);
+
+    std::vector<int> seedCells;
+    std::vector<int> stepsFromSeed(graph.numCells, std::numeric_limits<int>::max());
+    std::vector<bool> isSeed(graph.numCells, false);
+    std::queue<int> frontier;
+    for (const int candidate : candidates) {
+        if (static_cast<int>(seedCells.size()) == numRegions) {
+            break;
+        }
+        if (stepsFromSeed[candidate] < spacing) {
+            continue;
+        }
+        seedCells.push_back(candidate);
+        isSeed[candidate] = true;
+
+        // Mark everything within the spacing, stopping wherever an earlier
+        // seed is already at least as close
+        stepsFromSeed[candidate] = 0;
+        frontier.push(candidate);
+        while (!frontier.empty()) {
+            const int cell = frontier.front();
+            frontier.pop();
+            if (stepsFromSeed[cell] + 1 >= spacing) {
+                continue;
+            }
+            for (int j = graph.offsets[cell]; j < graph.offsets[cell + 1]; j++) {
+                const int neighbor = graph.neighbors[j];
+                if (stepsFromSeed[neighbor] > stepsFromSeed[cell] + 1) {
+                    stepsFromSeed[neighbor] = stepsFromSeed[cell] + 1;
+                    frontier.push(neighbor);
+                }
+            }
+        }
+    }
+    for (const int candidate : candidates) {
+        if (static_cast<int>(seedCells.size()) == numRegions) {
+            break;
+        }
+        if (!isSeed[candidate]) {
+            seedCells.push_back(candidate);
+            isSeed[candidate] = true;
+        }
+    }
+
+    return seedCells;
+}
+
+// Per-region totals, and which regions border each other
+static void gatherRegionStats(RegionMap& regions, const CellGraph& graph,
+    const std::vector<glm::vec2>& positions, const std::vector<float>& cellCosts,
+    const std::vector<float>& cellAreas) {
+    regions.regionAreas.assign(regions.numRegions, 0.0f);
+    regions.regionCentroids.assign(regions.numRegions, glm::vec2(0.0f));
+    regions.regionCosts.assign(regions.numRegions, 0.0f);
+    std::vector<std::vector<int>> neighborLists(regions.numRegions);
+
+    for (int i = 0; i < graph.numCells; i++) {
+        const int region = regions.cellRegions[i];
+        if (region == -1) {
+            continue;
+        }
+        regions.regionAreas[region] += cellAreas[i];
+        regions.regionCentroids[region] += cellAreas[i] * positions[i];
+        regions.regionCosts[region] += cellAreas[i] * cellCosts[i];
+
+        for (int j = graph.offsets[i]; j < graph.offsets[i + 1]; j++) {
+            const int neighborRegion = regions.cellRegions[graph.neighbors[j]];
+            if (neighborRegion != -1 && neighborRegion != region) {
+                neighborLists[region].push_back(neighborRegion);
+            }
+        }
+    }
+
+    for (int i = 0; i < regions.numRegions; i++) {
+        if (regions.regionAreas[i] > 0.0f) {
+            regions.regionCentroids[i] /= regions.regionAreas[i];
+            regions.regionCosts[i] /= regions.regionAreas[i];
+        }
+        else {
+            regions.regionCentroids[i] = positions[regions.seedCells[i]];
+            regions.regionCosts[i] = cellCosts[regions.seedCells[i]];
+        }
+        std::sort(neighborLists[i].begin(), neighborLists[i].end());
+        neighborLists[i].erase(std::unique(neighborLists[i].begin(), neighborLists[i].end()),
+            neighborLists[i].end());
+    }
+    regions.regionGraph = createCellGraph(neighborLists);
+}
+
+RegionMap generateRegions(const CellGraph& graph, const std::vector<glm::vec2>& positions,
+    const std::vector<float>& cellCosts, const std::vector<float>& cellAreas,
+    const std::vector<bool>& isClaimable, const int numRegions, const int seed) {
+    const int numCells = graph.numCells;
+    RegionMap regions;
+    regions.seedCells = pickSeedCells(graph, isClaimable, numRegions, seed);
+    regions.numRegions = static_cast<int>(regions.seedCells.size());
+
+    auto getEdgeCost = [&](const int from, const int to) {
+        return glm::length(positions[to] - positions[from]) *
+            (0.5f * (cellCosts[from] + cellCosts[to]));
+    };
+
+    // Cells are grown in buckets of this much distance at a time: everything
+    // under the current threshold is relaxed in parallel until it settles,
+    // then the threshold moves up. About two average edges per bucket keeps
+    // the buckets wide enough to split up without redoing much work.
+    double totalEdgeCost = 0.0;
+    for (int i = 0; i < numCells; i++) {
+        for (int j = graph.offsets[i]; j < graph.offsets[i + 1]; j++) {
+            totalEdgeCost += getEdgeCost(i, graph.neighbors[j]);
+        }
+    }
+    const float bucketWidth = graph.neighbors.empty() ? 1.0f :
+        static_cast<float>(2.0 * totalEdgeCost / static_cast<double>(graph.neighbors.size()));
+
+    // Cells only ever move to a smaller key, and the smallest key for every
+    // cell is the same however the updates are ordered, so threads can race
+    // to lower them
+    std::vector<std::atomic<u_int64_t>> keys(numCells);
+    std::vector<std::atomic<u_int8_t>> isPending(numCells);
+    for (int i = 0; i < numCells; i++) {
+        keys[i].store(UNREACHED_KEY, std::memory_order_relaxed);
+        isPending[i].store(false, std::memory_order_relaxed);
+    }
+    std::vector<int> pending;
+    for (int i = 0; i < regions.numRegions; i++) {
+        keys[regions.seedCells[i]].store(packRegionKey(0.0f, i), std::memory_order_relaxed);
+        isPending[regions.seedCells[i]].store(true, std::memory_order_relaxed);
+        pending.push_back(regions.seedCells[i]);
+    }
+
+    std::vector<int> active;
+    std::vector<int> deferred;
+    float threshold = bucketWidth;
+
+    // Moves every pending cell under the threshold into the active list,
+    // raising the threshold to the next non-empty bucket when there are none
+    auto selectActiveCells = [&]() {
+        active.clear();
+        while (!pending.empty()) {
+            float minDistance = std::numeric_limits<float>::max();
+            for (const int cell : pending) {
+                const float distance = getKeyDistance(keys[cell].load(std::memory_order_relaxed));
+                if (distance < threshold) {
+                    isPending[cell].store(false, std::memory_order_relaxed);
+                    active.push_back(cell);
+                }
+                else {
+                    minDistance = std::min(minDistance, distance);
+                    deferred.push_back(cell);
+                }
+            }
+            std::swap(pending, deferred);
+            deferred.clear();
+            if (!active.empty()) {
+                break;
+            }
+            threshold = (std::floor(minDistance / bucketWidth) + 1.0f) * bucketWidth;
+        }
+    };
+
+    // Relaxes the edges out of a range of active cells, and returns the
+    // neighbors that were lowered and aren't pending yet
+    auto relaxActiveCells = [&](const int begin, const int end) {
+        std::vector<int> lowered;
+        for (int i = begin; i < end; i++) {
+            const int cell = active[i];
+            const u_int64_t key = keys[cell].load(std::memory_order_relaxed);
+            const float distance = getKeyDistance(key);
+            const int region = getKeyRegion(key);
+
+            for (int j = graph.offsets[cell]; j < graph.offsets[cell + 1]; j++) {
+                const int neighbor = graph.neighbors[j];
+                const u_int64_t newKey = packRegionKey(distance + getEdgeCost(cell, neighbor),
+                    region);
+                u_int64_t oldKey = keys[neighbor].load(std::memory_order_relaxed);
+                while (newKey < oldKey &&
+                    !keys[neighbor].compare_exchange_weak(oldKey, newKey,
+                        std::memory_order_relaxed)) {
+                }
+                if (newKey < oldKey && !isPending[neighbor].exchange(true,
+                    std::memory_order_relaxed)) {
+                    lowered.push_back(neighbor);
+                }
+            }
+        }
+        return lowered;
+    };
+
+    // Each round relaxes all the active cells in parallel, then the cells
+    // they lowered are picked from for the next round
+    selectActiveCells();
+    while (!active.empty()) {
+        pending = parallelReduce(0, static_cast<int>(active.size()), RELAX_GRAIN_SIZE,
+            std::move(pending), relaxActiveCells,
+            [](std::vector<int>& total, const std::vector<int>& lowered) {
+                total.insert(total.end(), lowered.begin(), lowered.end());
+            });
+        selectActiveCells();
+    }
+
+    regions.cellRegions.resize(numCells);
+    for (int i = 0; i < numCells; i++) {
+        const u_int64_t key = keys[i].load(std::memory_order_relaxed);
+        regions.cellRegions[i] = (isClaimable[i] && key != UNREACHED_KEY) ?
+            getKeyRegion(key) : -1;
+    }
+    gatherRegionStats(regions, graph, positions, cellCosts, cellAreas);
+
+    return regions;
+}
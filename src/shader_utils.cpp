@@ -1,31 +1,49 @@
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
 #include <filesystem>
+#include <vector>
 
 #include <madoc/shader_utils.h>
 #include <madoc/log_utils.h>
+#include <madoc/embedded_shaders.h>
 
 
+// Start of every program cache file, changed whenever its layout does
+constexpr char PROGRAM_CACHE_MAGIC[8] = {'M', 'A', 'D', 'O', 'C', 'P', 'B', '1'};
+
 std::string readShaderFile(const std::string& filePath) {
     std::ifstream file(filePath);
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open shader file: " + filePath);
     }
     if (filePath.size() < 5 || filePath.substr(filePath.size() - 5) != ".glsl") {
-        logWarning("shader_utils", filePath + " is not a .glsl file");
+        MADOC_LOG(LOG_WARNING, "shader_utils", filePath + " is not a .glsl file");
     }
 
-    std::string line;
-    std::string outputString;
-    while (std::getline(file, line)) {
-        outputString += line;
-        outputString += "\n";
-    }
+    // Read the whole file at once rather than a line at a time
+    file.seekg(0, std::ios::end);
+    std::string outputString(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(outputString.data(), static_cast<std::streamsize>(outputString.size()));
 
     return outputString;
 }
 
+std::string getShaderSource(const std::string& name, const std::string& overrideDirectory) {
+    if (!overrideDirectory.empty()) {
+        return readShaderFile((std::filesystem::path(overrideDirectory) / name).string());
+    }
+
+    for (const EmbeddedShader& shader : EMBEDDED_SHADERS) {
+        if (name == shader.name) {
+            return shader.source;
+        }
+    }
+    throw std::runtime_error("No shader named " + name + " was built into the program");
+}
+
 GLuint createShader(const char* shaderSource, const ShaderType shaderType) {
     GLuint shader = 0;
     switch (shaderType) {
@@ -60,10 +78,12 @@ GLuint createShader(const char* shaderSource, const ShaderType shaderType) {
     return shader;
 }
 
-GLuint createShaderProgram(GLuint shaderList[]) {
+GLuint createShaderProgram(const std::span<const GLuint> shaderList) {
     const GLuint shaderProgram = glCreateProgram();
-    for (int i = 0; i < sizeof(shaderList) / sizeof(shaderList[0]); i++) {
-        glAttachShader(shaderProgram, shaderList[i]);
+    // Lets the linked program be saved by loadShaderProgram()
+    glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (const GLuint shader : shaderList) {
+        glAttachShader(shaderProgram, shader);
     }
     glLinkProgram(shaderProgram);
 
@@ -76,9 +96,145 @@ GLuint createShaderProgram(GLuint shaderList[]) {
                                  "OpenGL's log: " + std::string(infoLog));
     }
 
-    for (int i = 0; i < sizeof(shaderList) / sizeof(shaderList[0]); i++) {
-        glDeleteShader(shaderList[i]);
+    for (const GLuint shader : shaderList) {
+        glDeleteShader(shader);
     }
 
     return shaderProgram;
 }
+
+// A program binary only loads on the driver that made it, and is only good
+// for the source it was linked from, so both go into its cache key. The
+// source is hashed (64-bit FNV-1a) to keep the key short.
+static std::string getProgramCacheKey(const std::string& vertexSource,
+    const std::string& fragmentSource) {
+    u_int64_t hash = 14695981039346656037ull;
+    for (const std::string* source : {&vertexSource, &fragmentSource}) {
+        // Hash the terminators too, so moving text from one shader to the
+        // other changes the key
+        for (size_t i = 0; i <= source->size(); i++) {
+            hash = (hash ^ static_cast<u_int8_t>(source->c_str()[i])) * 1099511628211ull;
+        }
+    }
+
+    std::string key;
+    for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        const GLubyte* value = glGetString(name);
+        key += value == nullptr ? "" : reinterpret_cast<const char*>(value);
+        key += '\n';
+    }
+    return key + std::to_string(hash);
+}
+
+// Returns the cached program, or 0 if there's no cache file, it was made for
+// another key, or the driver won't take it anymore
+static GLuint loadCachedProgram(const std::string& cachePath, const std::string& key) {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    char magic[sizeof(PROGRAM_CACHE_MAGIC)];
+    u_int32_t keyLength = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&keyLength), sizeof(keyLength));
+    if (!file || !std::equal(magic, magic + sizeof(magic), PROGRAM_CACHE_MAGIC) ||
+        keyLength != key.size()) {
+        return 0;
+    }
+    std::string cachedKey(keyLength, '\0');
+    file.read(cachedKey.data(), keyLength);
+    if (!file || cachedKey != key) {
+        return 0;
+    }
+
+    GLenum binaryFormat = 0;
+    u_int32_t binaryLength = 0;
+    file.read(reinterpret_cast<char*>(&binaryFormat), sizeof(binaryFormat));
+    file.read(reinterpret_cast<char*>(&binaryLength), sizeof(binaryLength));
+    std::vector<char> binary(binaryLength);
+    file.read(binary.data(), binaryLength);
+    if (!file) {
+        MADOC_LOG(LOG_WARNING, "shader_utils", "Program cache " + cachePath + " is truncated");
+        return 0;
+    }
+
+    const GLuint shaderProgram = glCreateProgram();
+    glProgramBinary(shaderProgram, binaryFormat, binary.data(),
+        static_cast<GLsizei>(binaryLength));
+    int success;
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        logWarning("shader_utils", "The driver rejected the cached program; relinking");
+        glDeleteProgram(shaderProgram);
+        return 0;
+    }
+
+    return shaderProgram;
+}
+
+static void saveCachedProgram(const GLuint shaderProgram, const std::string& cachePath,
+    const std::string& key) {
+    GLint binaryLength = 0;
+    glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0) {
+        return;
+    }
+    std::vector<char> binary(binaryLength);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(shaderProgram, binaryLength, nullptr, &binaryFormat, binary.data());
+
+    // Failing to save only makes the next launch slower, so it isn't an error
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    const u_int32_t keyLength = static_cast<u_int32_t>(key.size());
+    const u_int32_t length = static_cast<u_int32_t>(binaryLength);
+    file.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+    file.write(key.data(), keyLength);
+    file.write(reinterpret_cast<const char*>(&binaryFormat), sizeof(binaryFormat));
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(binary.data(), binaryLength);
+    if (!file) {
+        MADOC_LOG(LOG_WARNING, "shader_utils", "Failed to write program cache " + cachePath);
+    }
+}
+
+GLuint loadShaderProgram(const std::string& vertexSource, const std::string& fragmentSource,
+    const std::string& cachePath) {
+    GLint numBinaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+    const bool useCache = !cachePath.empty() && numBinaryFormats > 0;
+
+    std::string key;
+    if (useCache) {
+        key = getProgramCacheKey(vertexSource, fragmentSource);
+        const GLuint shaderProgram = loadCachedProgram(cachePath, key);
+        if (shaderProgram != 0) {
+            return shaderProgram;
+        }
+    }
+
+    const GLuint vertexShader = createShader(vertexSource.c_str(), VERTEX);
+    const GLuint fragmentShader = createShader(fragmentSource.c_str(), FRAGMENT);
+    const GLuint shaderList[] = {vertexShader, fragmentShader};
+    const GLuint shaderProgram = createShaderProgram(shaderList);
+
+    if (useCache) {
+        saveCachedProgram(shaderProgram, cachePath, key);
+    }
+
+    return shaderProgram;
+}
+
+ShaderUniforms getShaderUniforms(const GLuint shaderProgram) {
+    ShaderUniforms uniforms;
+    uniforms.model = glGetUniformLocation(shaderProgram, "model");
+    uniforms.view = glGetUniformLocation(shaderProgram, "view");
+    uniforms.projection = glGetUniformLocation(shaderProgram, "projection");
+    uniforms.positionScale = glGetUniformLocation(shaderProgram, "positionScale");
+    uniforms.chunkOrigin = glGetUniformLocation(shaderProgram, "chunkOrigin");
+    uniforms.useCellColors = glGetUniformLocation(shaderProgram, "useCellColors");
+    uniforms.cellColors = glGetUniformLocation(shaderProgram, "cellColors");
+
+    return uniforms;
+}
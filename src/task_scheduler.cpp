@@ -0,0 +1,297 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <madoc/task_scheduler.h>
+
+
+// Tasks that are waited on together, and the first exception any of them threw
+struct TaskGroup {
+    std::atomic<int> numPending;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+struct Task {
+    std::function<void()> work;
+    TaskGroup* group;
+};
+
+// Owners push and pop at the back, thieves take from the front, so a worker
+// keeps running its newest (and most cache-friendly) tasks while others steal
+// its oldest (and usually biggest) ones
+struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+};
+
+// The workers, with one queue each, plus one last queue shared by every
+// thread that isn't a worker. The pool starts the first time it's used and
+// stops when the program exits.
+struct TaskScheduler {
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> numQueuedTasks;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    bool isStopping;
+
+    TaskScheduler();
+    ~TaskScheduler();
+};
+
+// Which queue the current thread owns, or -1 when it isn't a worker
+static thread_local int currentWorker = -1;
+
+static TaskScheduler& getTaskScheduler() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+static int getOwnQueue(const TaskScheduler& scheduler) {
+    return currentWorker == -1 ? static_cast<int>(scheduler.queues.size()) - 1 : currentWorker;
+}
+
+static void pushTasks(TaskScheduler& scheduler, std::vector<Task>& tasks) {
+    WorkerQueue& queue = *scheduler.queues[getOwnQueue(scheduler)];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (Task& task : tasks) {
+            queue.tasks.push_back(std::move(task));
+        }
+    }
+    scheduler.numQueuedTasks.fetch_add(static_cast<int>(tasks.size()));
+
+    // Taking the lock makes sure no worker is between finding nothing to do
+    // and going to sleep, which would miss the wake up
+    {
+        std::lock_guard<std::mutex> lock(scheduler.sleepMutex);
+    }
+    if (tasks.size() == 1) {
+        scheduler.wakeUp.notify_one();
+    }
+    else {
+        scheduler.wakeUp.notify_all();
+    }
+}
+
+// Takes the newest task from the thread's own queue, or failing that steals
+// the oldest task from another queue
+static bool popTask(TaskScheduler& scheduler, Task& task) {
+    if (scheduler.numQueuedTasks.load() == 0) {
+        return false;
+    }
+    const int numQueues = static_cast<int>(scheduler.queues.size());
+    const int ownQueue = getOwnQueue(scheduler);
+    for (int i = 0; i < numQueues; i++) {
+        WorkerQueue& queue = *scheduler.queues[(ownQueue + i) % numQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        scheduler.numQueuedTasks.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+static void recordError(TaskGroup& group) {
+    std::lock_guard<std::mutex> lock(group.errorMutex);
+    if (!group.error) {
+        group.error = std::current_exception();
+    }
+}
+
+// The group can be gone as soon as its last task is counted as done, so
+// nothing may touch it after that
+static void runTask(Task& task) {
+    try {
+        task.work();
+    }
+    catch (...) {
+        recordError(*task.group);
+    }
+    task.group->numPending.fetch_sub(1, std::memory_order_release);
+}
+
+// Runs queued tasks (the group's own or anyone else's) until every task in
+// the group is done
+static void waitForGroup(TaskScheduler& scheduler, TaskGroup& group) {
+    while (group.numPending.load(std::memory_order_acquire) > 0) {
+        Task task;
+        if (popTask(scheduler, task)) {
+            runTask(task);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    if (group.error) {
+        std::rethrow_exception(group.error);
+    }
+}
+
+static void runWorker(TaskScheduler& scheduler, const int index) {
+    currentWorker = index;
+    while (true) {
+        Task task;
+        if (popTask(scheduler, task)) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(scheduler.sleepMutex);
+        scheduler.wakeUp.wait(lock, [&scheduler]() {
+            return scheduler.isStopping || scheduler.numQueuedTasks.load() > 0;
+        });
+        if (scheduler.isStopping) {
+            return;
+        }
+    }
+}
+
+TaskScheduler::TaskScheduler() : numQueuedTasks(0), isStopping(false) {
+    // The thread that waits on work helps run it, so it counts as a core
+    const int numWorkers = std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0);
+    for (int i = 0; i <= numWorkers; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        workers.emplace_back(runWorker, std::ref(*this), i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isStopping = true;
+    }
+    wakeUp.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int getNumWorkerThreads() {
+    return static_cast<int>(getTaskScheduler().workers.size()) + 1;
+}
+
+void parallelFor(const int begin, const int end, const int grainSize,
+    const std::function<void(int, int)>& body) {
+    if (end <= begin) {
+        return;
+    }
+    const int chunkSize = std::max(grainSize, 1);
+    const int numChunks = ((end - begin) + chunkSize - 1) / chunkSize;
+    TaskScheduler& scheduler = getTaskScheduler();
+
+    // Nothing to split, or nobody to split it with
+    if (numChunks == 1 || scheduler.workers.empty()) {
+        for (int chunkBegin = begin; chunkBegin < end; chunkBegin += chunkSize) {
+            body(chunkBegin, std::min(chunkBegin + chunkSize, end));
+        }
+        return;
+    }
+
+    // Queue every chunk but the first, which this thread starts on right away.
+    // They're queued backwards, so this thread works forwards through them
+    // while other threads steal from the far end.
+    TaskGroup group;
+    group.numPending.store(numChunks);
+    std::vector<Task> tasks;
+    tasks.reserve(numChunks - 1);
+    for (int chunk = numChunks - 1; chunk > 0; chunk--) {
+        const int chunkBegin = begin + (chunk * chunkSize);
+        tasks.push_back({[&body, chunkBegin, chunkSize, end]() {
+            body(chunkBegin, std::min(chunkBegin + chunkSize, end));
+        }, &group});
+    }
+    pushTasks(scheduler, tasks);
+
+    Task firstChunk = {[&body, begin, chunkSize, end]() {
+        body(begin, std::min(begin + chunkSize, end));
+    }, &group};
+    runTask(firstChunk);
+    waitForGroup(scheduler, group);
+}
+
+int addTask(TaskGraph& graph, std::function<void()> task, const std::vector<int>& dependencies) {
+    const int index = static_cast<int>(graph.tasks.size());
+    for (const int dependency : dependencies) {
+        if (dependency < 0 || dependency >= index) {
+            throw std::runtime_error("Task " + std::to_string(index) +
+                " depends on task " + std::to_string(dependency) + ", which doesn't exist yet");
+        }
+        graph.dependents[dependency].push_back(index);
+    }
+    graph.tasks.push_back(std::move(task));
+    graph.dependents.emplace_back();
+    graph.numDependencies.push_back(static_cast<int>(dependencies.size()));
+
+    return index;
+}
+
+void runTaskGraph(const TaskGraph& graph) {
+    const int numTasks = static_cast<int>(graph.tasks.size());
+    if (numTasks == 0) {
+        return;
+    }
+    TaskScheduler& scheduler = getTaskScheduler();
+
+    // Each task queues up the dependents it was the last dependency of once
+    // it's done, so a task never sits in a queue waiting on anything
+    std::vector<std::atomic<int>> numWaiting(numTasks);
+    for (int i = 0; i < numTasks; i++) {
+        numWaiting[i].store(graph.numDependencies[i]);
+    }
+    std::atomic<bool> hasFailed(false);
+    TaskGroup group;
+    group.numPending.store(numTasks);
+
+    std::function<Task(int)> createTask = [&](const int index) {
+        return Task{[&, index]() {
+            if (!hasFailed.load()) {
+                try {
+                    graph.tasks[index]();
+                }
+                catch (...) {
+                    hasFailed.store(true);
+                    recordError(group);
+                }
+            }
+            std::vector<Task> readyTasks;
+            for (const int dependent : graph.dependents[index]) {
+                if (numWaiting[dependent].fetch_sub(1) == 1) {
+                    readyTasks.push_back(createTask(dependent));
+                }
+            }
+            if (!readyTasks.empty()) {
+                pushTasks(scheduler, readyTasks);
+            }
+        }, &group};
+    };
+
+    std::vector<Task> readyTasks;
+    for (int i = 0; i < numTasks; i++) {
+        if (graph.numDependencies[i] == 0) {
+            readyTasks.push_back(createTask(i));
+        }
+    }
+    pushTasks(scheduler, readyTasks);
+    waitForGroup(scheduler, group);
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+
+#include <madoc/borders.h>
+#include <madoc/terrain_editor.h>
+#include <madoc/world_mesh.h>
+
+
+CellVertexMap createCellVertexMap(const WorldMesh& mesh, const int numCells) {
+    // Counting sort by cell, which keeps each cell's vertices in order
+    CellVertexMap cellVertices;
+    cellVertices.offsets.assign(numCells + 1, 0);
+    for (const u_int32_t cellID : mesh.vertexCellIDs) {
+        cellVertices.offsets[cellID + 1]++;
+    }
+    for (int i = 0; i < numCells; i++) {
+        cellVertices.offsets[i + 1] += cellVertices.offsets[i];
+    }
+
+    cellVertices.vertices.resize(mesh.vertexCellIDs.size());
+    std::vector<int> nextSlot(cellVertices.offsets.begin(), cellVertices.offsets.end() - 1);
+    for (int i = 0; i < mesh.vertexCellIDs.size(); i++) {
+        cellVertices.vertices[nextSlot[mesh.vertexCellIDs[i]]++] = i;
+    }
+
+    return cellVertices;
+}
+
+DirtyCells createDirtyCells(const int numCells) {
+    DirtyCells dirtyCells;
+    dirtyCells.isDirty.assign(numCells, false);
+    return dirtyCells;
+}
+
+void applyBrush(World& world, const BiomeTable& biomeTable, const Brush& brush,
+    const glm::vec2 position, const float deltaTime, DirtyCells& dirtyCells) {
+    const int centerCell = getCellAtPosition(world.grid, world.meshScale, position);
+    if (centerCell == -1) {
+        return;
+    }
+
+    // A brush only ever covers a handful of cells, so checking the list is
+    // cheaper than clearing a visited flag for every cell in the world
+    std::vector<int> brushCells = {centerCell};
+    for (int i = 0; i < brushCells.size(); i++) {
+        const int cell = brushCells[i];
+        for (int j = world.cellGraph.offsets[cell]; j < world.cellGraph.offsets[cell + 1]; j++) {
+            const int neighbor = world.cellGraph.neighbors[j];
+            if (glm::length(world.cellCentroids[neighbor] - position) <= brush.radius &&
+                std::find(brushCells.begin(), brushCells.end(), neighbor) == brushCells.end()) {
+                brushCells.push_back(neighbor);
+            }
+        }
+    }
+
+    for (const int cell : brushCells) {
+        const u_int8_t oldBiome = world.cellBiomes[cell];
+        if (brush.mode == PAINT_BRUSH) {
+            world.cellBiomes[cell] = brush.biome;
+        }
+        else {
+            const float falloff = std::max(1.0f -
+                (glm::length(world.cellCentroids[cell] - position) / brush.radius), 0.0f);
+            const float change = brush.strength * falloff * deltaTime;
+            float& elevation = world.cellElevations[cell];
+            elevation = std::clamp(elevation + (brush.mode == RAISE_BRUSH ? change : -change),
+                0.0f, 1.0f);
+            world.cellBiomes[cell] = classifyBiome(biomeTable, elevation,
+                world.climate.temperature[cell], world.climate.precipitation[cell]);
+        }
+
+        // Cells that crossed sea level move the coast, so their borders are
+        // retagged when they're uploaded
+        bool isShoreChanged = false;
+        if (!world.isLandCell.empty()) {
+            const bool isLand = world.cellElevations[cell] >= biomeTable.seaLevel;
+            isShoreChanged = isLand != world.isLandCell[cell];
+            world.isLandCell[cell] = isLand;
+        }
+
+        if (world.cellBiomes[cell] != oldBiome || isShoreChanged) {
+            std::copy_n(&biomeTable.packedColors[world.cellBiomes[cell] * 4], 4,
+                &world.cellColors[cell * 4]);
+            if (!world.cellShades.empty()) {
+                shadeCellColor(world.cellColors, cell, world.cellShades[cell]);
+            }
+            if (!dirtyCells.isDirty[cell]) {
+                dirtyCells.isDirty[cell] = true;
+                dirtyCells.cells.push_back(cell);
+            }
+        }
+    }
+}
+
+std::vector<IndexRange> coalesceIndices(std::vector<int> indices, const int maxGap) {
+    std::sort(indices.begin(), indices.end());
+
+    std::vector<IndexRange> ranges;
+    for (const int index : indices) {
+        if (!ranges.empty() && index - (ranges.back().first + ranges.back().count) <= maxGap) {
+            ranges.back().count = std::max(ranges.back().count,
+                index - ranges.back().first + 1);
+        }
+        else {
+            ranges.push_back({index, 1});
+        }
+    }
+
+    return ranges;
+}
+
+void uploadDirtyCells(World& world, const BiomeTable& biomeTable,
+    const CellVertexMap& cellVertices, const CellAttributeBuffer& attributeBuffer,
+    const VertexFormat format, const GLuint VBO, const GLuint borderVBO,
+    DirtyCells& dirtyCells) {
+    if (dirtyCells.cells.empty()) {
+        return;
+    }
+
+    for (const IndexRange& range : coalesceIndices(dirtyCells.cells, MAX_DIRTY_CELL_GAP)) {
+        updateCellColors(attributeBuffer, world.cellColors, range.first, range.count);
+    }
+
+    if (format != CELL_ID_VERTEX) {
+        std::vector<int> dirtyVertices;
+        for (const int cell : dirtyCells.cells) {
+            const std::vector<float>& color = biomeTable.biomes[world.cellBiomes[cell]].color;
+            const float shade = world.cellShades.empty() ? 1.0f : world.cellShades[cell];
+            for (int i = cellVertices.offsets[cell]; i < cellVertices.offsets[cell + 1]; i++) {
+                const int vertex = cellVertices.vertices[i];
+                for (int channel = 0; channel < 3; channel++) {
+                    world.mesh.vertices[(vertex * 6) + 3 + channel] = color[channel] * shade;
+                }
+                dirtyVertices.push_back(vertex);
+            }
+        }
+        for (const IndexRange& range : coalesceIndices(std::move(dirtyVertices),
+            MAX_DIRTY_VERTEX_GAP)) {
+            updateWorldMeshVertices(world.mesh, format, VBO, range.first, range.count);
+        }
+    }
+
+    // Worlds without borders (like previews) have no coast to move
+    if (!world.borderMesh.cellSegmentOffsets.empty()) {
+        std::vector<int> changedSlots = retagBorderSegments(world.borderMesh,
+            world.borderSegments, dirtyCells.cells, world.isLandCell, world.provinces,
+            world.nations);
+        for (const IndexRange& range : coalesceIndices(std::move(changedSlots),
+            MAX_DIRTY_VERTEX_GAP)) {
+            updateBorderMeshSlots(world.borderMesh, borderVBO, range.first, range.count);
+        }
+    }
+
+    for (const int cell : dirtyCells.cells) {
+        dirtyCells.isDirty[cell] = false;
+    }
+    dirtyCells.cells.clear();
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <limits>
+
+#include <madoc/vertex_format.h>
+
+
+/*
+ * Converts a world space coordinate into a fixed-point offset from the origin
+ */
+int16_t toFixedPoint(const float coordinate, const float origin) {
+    float fixedCoordinate = std::round((coordinate - origin) * COMPACT_POSITION_SCALE);
+    if (fixedCoordinate < std::numeric_limits<int16_t>::min() ||
+        fixedCoordinate > std::numeric_limits<int16_t>::max()) {
+        throw std::runtime_error("Vertex is out of range of its chunk origin; "
+                                 "cannot pack it into a fixed-point vertex.");
+    }
+
+    return static_cast<int16_t>(fixedCoordinate);
+}
+
+std::vector<CompactVertex> packCompactVertices(const std::vector<float>& vertices,
+    const glm::vec2 origin) {
+    std::vector<CompactVertex> compactVertices;
+    compactVertices.reserve(vertices.size() / 6);
+
+    for (int i = 0; i + 5 < vertices.size(); i += 6) {
+        // Colors are stored as 0-255 and normalized back to 0-1 by OpenGL
+        CompactVertex currentVertex;
+        currentVertex.x = toFixedPoint(vertices[i], origin.x);
+        currentVertex.y = toFixedPoint(vertices[i + 1], origin.y);
+        currentVertex.r = static_cast<u_int8_t>(std::round(glm::clamp(vertices[i + 3], 0.0f, 1.0f) * 255.0f));
+        currentVertex.g = static_cast<u_int8_t>(std::round(glm::clamp(vertices[i + 4], 0.0f, 1.0f) * 255.0f));
+        currentVertex.b = static_cast<u_int8_t>(std::round(glm::clamp(vertices[i + 5], 0.0f, 1.0f) * 255.0f));
+        currentVertex.a = 255;
+        compactVertices.push_back(currentVertex);
+    }
+
+    return compactVertices;
+}
+
+std::vector<CellVertex> packCellVertices(const std::vector<float>& vertices,
+    const std::vector<u_int32_t>& cellIDs, const glm::vec2 origin) {
+    if (cellIDs.size() != vertices.size() / 6) {
+        throw std::runtime_error("Every vertex needs exactly one cell ID; "
+                                 "cannot pack cell vertices.");
+    }
+
+    std::vector<CellVertex> cellVertices;
+    cellVertices.reserve(cellIDs.size());
+
+    for (int i = 0; i < cellIDs.size(); i++) {
+        CellVertex currentVertex;
+        currentVertex.x = toFixedPoint(vertices[i * 6], origin.x);
+        currentVertex.y = toFixedPoint(vertices[(i * 6) + 1], origin.y);
+        currentVertex.cellID = cellIDs[i];
+        cellVertices.push_back(currentVertex);
+    }
+
+    return cellVertices;
+}
+
+GLsizei getVertexStride(const VertexFormat format) {
+    switch (format) {
+        case FLOAT_VERTEX:
+            return 6 * sizeof(float);
+        case COMPACT_VERTEX:
+            return sizeof(CompactVertex);
+        case CELL_ID_VERTEX:
+            return sizeof(CellVertex);
+        default:
+            throw std::runtime_error("Unknown vertex format. Cannot get its stride.");
+    }
+}
+
+void setVertexAttributes(const VertexFormat format) {
+    const GLsizei stride = getVertexStride(format);
+    switch (format) {
+        case FLOAT_VERTEX:
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                static_cast<void *>(nullptr));
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                reinterpret_cast<void *>(3 * sizeof(float)));
+            break;
+        case COMPACT_VERTEX:
+            // Positions stay as raw fixed-point values and get scaled in the shader
+            glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, stride,
+                static_cast<void *>(nullptr));
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                reinterpret_cast<void *>(offsetof(CompactVertex, r)));
+            break;
+        case CELL_ID_VERTEX:
+            glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, stride,
+                static_cast<void *>(nullptr));
+            // The ID has to stay an integer so it can index the attribute buffer
+            glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, stride,
+                reinterpret_cast<void *>(offsetof(CellVertex, cellID)));
+            break;
+        default:
+            throw std::runtime_error("Unknown vertex format. Cannot set its attributes.");
+    }
+    glEnableVertexAttribArray(0);
+    if (format == CELL_ID_VERTEX) {
+        glDisableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+    }
+    else {
+        glEnableVertexAttribArray(1);
+        glDisableVertexAttribArray(2);
+    }
+}
+
+void setVertexFormatUniforms(const ShaderUniforms& uniforms, const VertexFormat format,
+    const glm::vec2 origin) {
+    // Float vertices are already in world space
+    if (format == FLOAT_VERTEX) {
+        glUniform1f(uniforms.positionScale, 1.0f);
+        glUniform2f(uniforms.chunkOrigin, 0.0f, 0.0f);
+    }
+    else {
+        glUniform1f(uniforms.positionScale, COMPACT_POSITION_SCALE);
+        glUniform2f(uniforms.chunkOrigin, origin.x, origin.y);
+    }
+    glUniform1i(uniforms.useCellColors, format == CELL_ID_VERTEX);
+}
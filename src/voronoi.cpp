@@ -1,12 +1,219 @@
 #include <iostream>
 #include <iomanip>
 #include <random>
-
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <glm/glm.hpp>
+
+#include <madoc/task_scheduler.h>
 #include <madoc/voronoi.h>
 
 
+// How many spots Bridson's algorithm tries around a point before giving up on it
+constexpr int POISSON_DISK_ATTEMPTS = 16;
+
+
+// Empty stats, with bounds that any grid cell will shrink down onto
+static VoronoiCellStats getEmptyCellStats() {
+    return {0, 0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max(),
+        std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+}
+
+// The stats of just the voronoi cells that labeling one macro cell touched,
+// gathered from empty stats, so their count and sums can be negative when
+// relabeling took grid cells away. Bounds can't shrink that way, so the cells
+// that lost grid cells are listed in shrunkCells.
+struct MacroCellLabels {
+    std::vector<u_int16_t> cellIDs;
+    std::vector<VoronoiCellStats> cellStats;
+    std::vector<u_int16_t> shrunkCells;
+};
+
+// Adds the stats a macro cell gathered onto the totals
+static void mergeCellStats(std::vector<VoronoiCellStats>& cellStats,
+    const MacroCellLabels& labels) {
+    for (int i = 0; i < labels.cellIDs.size(); i++) {
+        VoronoiCellStats& stats = cellStats[labels.cellIDs[i]];
+        const VoronoiCellStats& partial = labels.cellStats[i];
+        stats.count += partial.count;
+        stats.sumX += partial.sumX;
+        stats.sumY += partial.sumY;
+        stats.minX = std::min(stats.minX, partial.minX);
+        stats.minY = std::min(stats.minY, partial.minY);
+        stats.maxX = std::max(stats.maxX, partial.maxX);
+        stats.maxY = std::max(stats.maxY, partial.maxY);
+    }
+}
+
+// Macro cells are labeled in parallel this many at a time. Each one only
+// keeps stats for the handful of voronoi cells it touches, so they take no
+// more memory however many threads there are, and since the stats are exact
+// integer sums and bounds, merging them after gives the same totals however
+// the macro cells were split up.
+constexpr int LABEL_GRAIN_SIZE = 16;
+
+// Labels every grid cell in a macro cell with its closest feature point, and
+// gathers the stats of the voronoi cells they went to into labels. When
+// relabeling, each grid cell that changes is taken back out of the stats of
+// its old voronoi cell, and the old cell is listed in labels.shrunkCells.
+static void labelMacroCell(VoronoiGrid& inputGrid, const int macroX, const int macroY,
+    const bool isRelabeling, MacroCellLabels& labels) {
+    const int numMacroX = inputGrid.width / inputGrid.macroWidth;
+    const int numMacroY = inputGrid.height / inputGrid.macroHeight;
+
+    // Get all valid macro cells within the search radius and the feature points
+    // in those macro cells, once for the whole macro cell. They're copied into
+    // flat lists so the distance loop below stays tight.
+    const int searchRadius = inputGrid.searchRadius;
+    const int startingX = macroX * inputGrid.macroWidth;
+    const int startingY = macroY * inputGrid.macroHeight;
+    std::vector<int> candidateX, candidateY;
+    std::vector<u_int16_t> candidateIDs;
+    for (int checkedMacroY = macroY - searchRadius; checkedMacroY <= macroY + searchRadius;
+        checkedMacroY++) {
+        for (int checkedMacroX = macroX - searchRadius; checkedMacroX <= macroX + searchRadius;
+            checkedMacroX++) {
+            if (checkedMacroX >= 0 && checkedMacroX < numMacroX &&
+                checkedMacroY >= 0 && checkedMacroY < numMacroY) {
+                const MacroCell& currentMacroCell =
+                    inputGrid.macroCells[(checkedMacroY * numMacroX) + checkedMacroX];
+                for (const FeaturePoint& featurePoint : currentMacroCell.featurePoints) {
+                    // Skip points that are provably too far from every grid
+                    // cell in this macro cell
+                    if (inputGrid.coverageDistance > 0) {
+                        const int dx = std::max({startingX - featurePoint.x, 0,
+                            featurePoint.x - (startingX + inputGrid.macroWidth - 1)});
+                        const int dy = std::max({startingY - featurePoint.y, 0,
+                            featurePoint.y - (startingY + inputGrid.macroHeight - 1)});
+                        if ((dx * dx) + (dy * dy) > inputGrid.coverageDistance *
+                            inputGrid.coverageDistance) {
+                            continue;
+                        }
+                    }
+                    candidateX.push_back(featurePoint.x);
+                    candidateY.push_back(featurePoint.y);
+                    candidateIDs.push_back(featurePoint.voronoiID);
+                }
+            }
+        }
+    }
+
+    // Stats are gathered per candidate. Old cells that relabeling takes grid
+    // cells from without being candidates get added after the candidates.
+    const int numCandidates = static_cast<int>(candidateIDs.size());
+    std::vector<VoronoiCellStats> candidateStats(numCandidates, getEmptyCellStats());
+    labels.shrunkCells.clear();
+
+    for (int y = startingY; y < startingY + inputGrid.macroHeight; y++) {
+        for (int x = startingX; x < startingX + inputGrid.macroWidth; x++) {
+            int shortestDistance = std::numeric_limits<int>::max();
+            int closest = 0;
+
+            // For each feature point nearby, calculate the distance and check
+            // whether it's the shortest
+            for (int i = 0; i < numCandidates; i++) {
+                int dx = candidateX[i] - x;
+                int dy = candidateY[i] - y;
+                int distance = (dx * dx) + (dy * dy);
+
+                if (distance < shortestDistance) {
+                    closest = i;
+                    shortestDistance = distance;
+                }
+            }
+            const u_int16_t cellID = candidateIDs[closest];
+
+            // Set the cell's final voronoiID and update the stats
+            u_int16_t& currentCell = inputGrid.cells[(y * inputGrid.width) + x];
+            if (isRelabeling) {
+                if (currentCell == cellID) {
+                    continue;
+                }
+                const int oldIndex = static_cast<int>(std::find(candidateIDs.begin(),
+                    candidateIDs.end(), currentCell) - candidateIDs.begin());
+                if (oldIndex == candidateIDs.size()) {
+                    candidateIDs.push_back(currentCell);
+                    candidateStats.push_back(getEmptyCellStats());
+                }
+                VoronoiCellStats& oldStats = candidateStats[oldIndex];
+                oldStats.count--;
+                oldStats.sumX -= x;
+                oldStats.sumY -= y;
+                if (std::find(labels.shrunkCells.begin(), labels.shrunkCells.end(),
+                    currentCell) == labels.shrunkCells.end()) {
+                    labels.shrunkCells.push_back(currentCell);
+                }
+            }
+            currentCell = cellID;
+            VoronoiCellStats& newStats = candidateStats[closest];
+            newStats.count++;
+            newStats.sumX += x;
+            newStats.sumY += y;
+            newStats.minX = std::min(newStats.minX, x);
+            newStats.minY = std::min(newStats.minY, y);
+            newStats.maxX = std::max(newStats.maxX, x);
+            newStats.maxY = std::max(newStats.maxY, y);
+        }
+    }
+
+    // Only the cells that something happened to are kept
+    labels.cellIDs.clear();
+    labels.cellStats.clear();
+    for (int i = 0; i < candidateIDs.size(); i++) {
+        const VoronoiCellStats& stats = candidateStats[i];
+        if (stats.count != 0 || stats.minX != std::numeric_limits<int>::max()) {
+            labels.cellIDs.push_back(candidateIDs[i]);
+            labels.cellStats.push_back(stats);
+        }
+    }
+}
+
+
+// Points each voronoiID at its feature point and labels the whole grid. Both
+// point generators end with this once their macro cells are filled in.
+static void finishVoronoiCells(VoronoiGrid& inputGrid) {
+    const int numMacroX = inputGrid.width / inputGrid.macroWidth;
+    const int numMacroY = inputGrid.height / inputGrid.macroHeight;
+
+    // Get a list of points to each voronoi cell in order by their voronoiID
+    inputGrid.featurePointPointers.clear();
+    inputGrid.featurePointPointers.reserve(inputGrid.numFeaturePoints);
+    for (int i = 0; i < inputGrid.macroCells.size(); i++) {
+        for (int j = 0; j < inputGrid.macroCells[i].featurePoints.size(); j++) {
+            FeaturePoint* currentPointPointer =
+                &inputGrid.macroCells[i].featurePoints[j];
+            inputGrid.featurePointPointers.push_back(currentPointPointer);
+        }
+    }
+
+    // Label every grid cell with its closest feature point. Macro cells never
+    // write to the same grid cells, and each keeps the stats of the voronoi
+    // cells it touched, which are merged after.
+    const int numMacroCells = numMacroX * numMacroY;
+    std::vector<MacroCellLabels> macroLabels(numMacroCells);
+    parallelFor(0, numMacroCells, LABEL_GRAIN_SIZE, [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++) {
+            labelMacroCell(inputGrid, i % numMacroX, i / numMacroX, false, macroLabels[i]);
+        }
+    });
+    inputGrid.cellStats.assign(inputGrid.numFeaturePoints, getEmptyCellStats());
+    for (const MacroCellLabels& labels : macroLabels) {
+        mergeCellStats(inputGrid.cellStats, labels);
+    }
+}
+
 VoronoiGrid createVoronoiGrid(const int width, const int height,
     const int macroWidth, const int macroHeight) {
+    if (width <= 0 || height <= 0 || macroWidth <= 0 || macroHeight <= 0 ||
+        width % macroWidth != 0 || height % macroHeight != 0) {
+        throw std::runtime_error("A " + std::to_string(width) + "x" + std::to_string(height) +
+            " grid isn't a whole number of " + std::to_string(macroWidth) + "x" +
+            std::to_string(macroHeight) + " macro cells");
+    }
+
     VoronoiGrid outputGrid;
 
     outputGrid.width = width;
@@ -14,32 +221,49 @@ VoronoiGrid createVoronoiGrid(const int width, const int height,
 
     outputGrid.cells.resize(width * height);
 
-    // TODO: Check that width/height is evenly divisible by macroWidth/macroHeight
     outputGrid.macroWidth = macroWidth;
     outputGrid.macroHeight = macroHeight;
 
     outputGrid.numFeaturePoints = 0;
+    outputGrid.searchRadius = 1;
+    outputGrid.coverageDistance = 0;
 
     return outputGrid;
 }
 
 void generateVoronoiCells(VoronoiGrid &inputGrid, const int seed,
     const int minFeaturePoints, const int maxFeaturePoints) {
-    // Random integer generation
-    std::mt19937 generator(seed);
-    std::uniform_int_distribution<int> randomX(0, inputGrid.macroWidth - 1);
-    std::uniform_int_distribution<int> randomY(0, inputGrid.macroHeight - 1);
-    std::uniform_int_distribution<int> randomFeaturePoints(minFeaturePoints, maxFeaturePoints);
-
     const int numMacroX = inputGrid.width / inputGrid.macroWidth;
     const int numMacroY = inputGrid.height / inputGrid.macroHeight;
-    u_int16_t voronoiID = 0;
-    std::vector<int> generatedPoints;
-
-    // Randomly assign some grid cells as feature points
-    for (int macroY = 0; macroY < numMacroY; macroY++) {
-        for (int macroX = 0; macroX < numMacroX; macroX++) {
-            std::vector<FeaturePoint> featurePoints;
+    const int numMacroCells = numMacroX * numMacroY;
+    // Duplicate points are drawn again, so a macro cell can't be asked for
+    // more points than it has grid cells
+    const int macroArea = inputGrid.macroWidth * inputGrid.macroHeight;
+    if (minFeaturePoints < 1 || maxFeaturePoints < minFeaturePoints ||
+        maxFeaturePoints > macroArea) {
+        throw std::runtime_error("Can't place " + std::to_string(minFeaturePoints) + " to " +
+            std::to_string(maxFeaturePoints) + " feature points in a macro cell of " +
+            std::to_string(macroArea) + " grid cells");
+    }
+    inputGrid.macroCells.resize(numMacroCells);
+
+    // Randomly assign some grid cells as feature points. Every macro cell
+    // gets its own generator seeded from its index, so they can be filled in
+    // parallel and still come out the same for a given seed.
+    parallelFor(0, numMacroCells, 64, [&](const int begin, const int end) {
+        for (int macroIndex = begin; macroIndex < end; macroIndex++) {
+            const int macroX = macroIndex % numMacroX;
+            const int macroY = macroIndex / numMacroX;
+            std::seed_seq macroSeed = {seed, macroIndex};
+            std::mt19937 generator(macroSeed);
+            std::uniform_int_distribution<int> randomX(0, inputGrid.macroWidth - 1);
+            std::uniform_int_distribution<int> randomY(0, inputGrid.macroHeight - 1);
+            std::uniform_int_distribution<int> randomFeaturePoints(minFeaturePoints,
+                maxFeaturePoints);
+
+            std::vector<FeaturePoint>& featurePoints =
+                inputGrid.macroCells[macroIndex].featurePoints;
+            featurePoints.clear();
             featurePoints.reserve(maxFeaturePoints);
             for (int i = 0; i < randomFeaturePoints(generator); i++) {
                 int featurePointX = randomX(generator) +
@@ -47,106 +271,341 @@ void generateVoronoiCells(VoronoiGrid &inputGrid, const int seed,
                 int featurePointY = randomY(generator) +
                     (macroY * inputGrid.macroHeight);
 
-                // Check if the generated point is a duplicate
+                // Check if the generated point is a duplicate. Points can only
+                // collide with others in the same macro cell.
                 bool duplicatePoint = false;
-                for (int j = 0; j < generatedPoints.size(); j += 2) {
-                    if (generatedPoints[j] == featurePointX &&
-                        generatedPoints[j + 1] == featurePointY) {
+                for (const FeaturePoint& featurePoint : featurePoints) {
+                    if (featurePoint.x == featurePointX && featurePoint.y == featurePointY) {
                         duplicatePoint = true;
                         i--;
                     }
                 }
-                generatedPoints.push_back(featurePointX);
-                generatedPoints.push_back(featurePointY);
-
-                // Edit the grid to include the feature point
                 if (!duplicatePoint) {
-                    inputGrid.cells[(featurePointY * inputGrid.width) +
-                        featurePointX] = voronoiID;
-                    featurePoints.push_back({featurePointX, featurePointY,
-                        voronoiID});
-                    inputGrid.numFeaturePoints++;
-                    voronoiID++;
+                    featurePoints.push_back({featurePointX, featurePointY, 0});
                 }
             }
-            inputGrid.macroCells.push_back({featurePoints});
-            featurePoints.clear();
         }
+    });
+
+    int numPoints = 0;
+    for (const MacroCell& macroCell : inputGrid.macroCells) {
+        numPoints += static_cast<int>(macroCell.featurePoints.size());
+    }
+    if (numPoints > MAX_FEATURE_POINTS) {
+        throw std::runtime_error("Grid has " + std::to_string(numPoints) +
+            " feature points, more than the " + std::to_string(MAX_FEATURE_POINTS) +
+            " that 16 bit voronoiIDs can number");
     }
 
-    // Get a list of points to each voronoi cell in order by their voronoiID
-    inputGrid.featurePointPointers.reserve(maxFeaturePoints * numMacroX *numMacroY);
-    for (int i = 0; i < inputGrid.macroCells.size(); i++) {
-        for (int j = 0; j < inputGrid.macroCells[i].featurePoints.size(); j++) {
-            FeaturePoint* currentPointPointer =
-                &inputGrid.macroCells[i].featurePoints[j];
-            inputGrid.featurePointPointers.push_back(currentPointPointer);
+    // Hand out voronoiIDs in macro cell order and mark the points on the grid
+    u_int16_t voronoiID = 0;
+    for (MacroCell& macroCell : inputGrid.macroCells) {
+        for (FeaturePoint& featurePoint : macroCell.featurePoints) {
+            featurePoint.voronoiID = voronoiID;
+            inputGrid.cells[(featurePoint.y * inputGrid.width) + featurePoint.x] = voronoiID;
+            inputGrid.numFeaturePoints++;
+            voronoiID++;
         }
     }
 
-    // Iterate through each grid cell, getting what macro cell it's in
-    for (int y = 0; y < inputGrid.height; y++) {
-        for (int x = 0; x < inputGrid.width; x++) {
-            int currentMacroX = x / inputGrid.macroWidth;
-            int currentMacroY = y / inputGrid.macroHeight;
+    finishVoronoiCells(inputGrid);
+}
 
-            int shortestDistance = std::numeric_limits<int>::max();
-            u_int16_t cellID;
-
-            // Get all valid adjacent macro cells and the feature points in those macro cells
-            for (int checkedMacroY = currentMacroY - 1;
-                checkedMacroY <= currentMacroY + 1; checkedMacroY++) {
-                for (int checkedMacroX = currentMacroX - 1;
-                    checkedMacroX <= currentMacroX + 1; checkedMacroX++) {
-                    if (checkedMacroX >= 0 && checkedMacroX < numMacroX &&
-                        checkedMacroY >= 0 && checkedMacroY < numMacroY) {
-                        MacroCell& currentMacroCell =
-                            inputGrid.macroCells[(checkedMacroY * numMacroX) + checkedMacroX];
-                        std::vector<FeaturePoint>& currentFeaturePoints =
-                            currentMacroCell.featurePoints;
-
-                        // For each feature point in this macro cell, calculate the distance
-                        // and check whether it's the shortest
-                        for (int i = 0; i < currentFeaturePoints.size(); i++) {
-                            int dx = currentFeaturePoints[i].x - x;
-                            int dy = currentFeaturePoints[i].y - y;
-                            int distance = (dx * dx) + (dy * dy);
-
-                            if (distance < shortestDistance) {
-                                cellID = currentFeaturePoints[i].voronoiID;
-                                shortestDistance = distance;
-                            }
+void generatePoissonDiskCells(VoronoiGrid& inputGrid, const int seed, const float minDistance) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> randomUnit(0.0f, 1.0f);
+
+    const int numMacroX = inputGrid.width / inputGrid.macroWidth;
+    const int numMacroY = inputGrid.height / inputGrid.macroHeight;
+    const int sampleWidth = numMacroX * inputGrid.macroWidth;
+    const int sampleHeight = numMacroY * inputGrid.macroHeight;
+    const float minDistanceSquared = minDistance * minDistance;
+
+    // Background grid for rejecting points that are too close. Its cells are
+    // small enough that each one holds at most one point, so checking the 5x5
+    // cells around a spot finds every point within minDistance of it.
+    const float accelerationSize = minDistance / std::sqrt(2.0f);
+    const int accelerationWidth = static_cast<int>(std::ceil(sampleWidth / accelerationSize));
+    const int accelerationHeight = static_cast<int>(std::ceil(sampleHeight / accelerationSize));
+    std::vector<int> accelerationGrid(accelerationWidth * accelerationHeight, -1);
+    std::vector<glm::ivec2> points;
+    std::vector<int> activePoints;
+
+    auto isFarEnough = [&](const glm::ivec2 point) {
+        const int cellX = static_cast<int>(point.x / accelerationSize);
+        const int cellY = static_cast<int>(point.y / accelerationSize);
+        for (int y = std::max(cellY - 2, 0); y <= std::min(cellY + 2, accelerationHeight - 1); y++) {
+            for (int x = std::max(cellX - 2, 0); x <= std::min(cellX + 2, accelerationWidth - 1); x++) {
+                const int neighbor = accelerationGrid[(y * accelerationWidth) + x];
+                if (neighbor != -1) {
+                    const glm::ivec2 delta = points[neighbor] - point;
+                    if ((delta.x * delta.x) + (delta.y * delta.y) < minDistanceSquared) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    };
+    auto addPoint = [&](const glm::ivec2 point) {
+        const int cellX = static_cast<int>(point.x / accelerationSize);
+        const int cellY = static_cast<int>(point.y / accelerationSize);
+        accelerationGrid[(cellY * accelerationWidth) + cellX] = static_cast<int>(points.size());
+        activePoints.push_back(static_cast<int>(points.size()));
+        points.push_back(point);
+    };
+
+    // Bridson's algorithm: keep trying spots around an active point, and retire
+    // the point once they've all failed. The spots are evenly spaced around a
+    // circle just past minDistance, from a random starting angle, which packs
+    // the points tighter and needs fewer tries than fully random spots would.
+    const float stepAngle = 2.0f * std::numbers::pi_v<float> / POISSON_DISK_ATTEMPTS;
+    const glm::vec2 stepRotation = {std::cos(stepAngle), std::sin(stepAngle)};
+    const float candidateDistance = minDistance + 1.0f;
+    addPoint({static_cast<int>(randomUnit(generator) * (sampleWidth - 1)),
+        static_cast<int>(randomUnit(generator) * (sampleHeight - 1))});
+    while (!activePoints.empty()) {
+        const int activeIndex = static_cast<int>(randomUnit(generator) * activePoints.size()) %
+            static_cast<int>(activePoints.size());
+        const glm::ivec2 activePoint = points[activePoints[activeIndex]];
+
+        const float startAngle = randomUnit(generator) * 2.0f * std::numbers::pi_v<float>;
+        glm::vec2 direction = {std::cos(startAngle), std::sin(startAngle)};
+        bool foundPoint = false;
+        for (int attempt = 0; attempt < POISSON_DISK_ATTEMPTS; attempt++) {
+            const glm::ivec2 candidate = {
+                static_cast<int>(std::lround(activePoint.x + (candidateDistance * direction.x))),
+                static_cast<int>(std::lround(activePoint.y + (candidateDistance * direction.y)))};
+
+            if (candidate.x >= 0 && candidate.x < sampleWidth &&
+                candidate.y >= 0 && candidate.y < sampleHeight && isFarEnough(candidate)) {
+                addPoint(candidate);
+                foundPoint = true;
+                break;
+            }
+
+            direction = {(direction.x * stepRotation.x) - (direction.y * stepRotation.y),
+                (direction.x * stepRotation.y) + (direction.y * stepRotation.x)};
+        }
+
+        if (!foundPoint) {
+            activePoints[activeIndex] = activePoints.back();
+            activePoints.pop_back();
+        }
+    }
+
+    // Bridson's tries are random, so a few gaps can slip through. Filling any
+    // background cell whose center is still minDistance from every point puts
+    // every grid cell within 1.5 * minDistance (plus rounding) of a point,
+    // which is what bounds the labeling search below.
+    for (int y = 0; y < accelerationHeight; y++) {
+        for (int x = 0; x < accelerationWidth; x++) {
+            const glm::ivec2 center = {
+                std::min(static_cast<int>((x + 0.5f) * accelerationSize), sampleWidth - 1),
+                std::min(static_cast<int>((y + 0.5f) * accelerationSize), sampleHeight - 1)};
+            if (accelerationGrid[(y * accelerationWidth) + x] == -1 && isFarEnough(center)) {
+                addPoint(center);
+            }
+        }
+    }
+
+    if (points.size() > MAX_FEATURE_POINTS) {
+        throw std::runtime_error("Grid has " + std::to_string(points.size()) +
+            " feature points, more than the " + std::to_string(MAX_FEATURE_POINTS) +
+            " that 16 bit voronoiIDs can number");
+    }
+
+    // Sort the points into macro cells, giving out voronoiIDs in macro cell order
+    inputGrid.macroCells.assign(numMacroX * numMacroY, {});
+    for (const glm::ivec2 point : points) {
+        const int macroIndex = ((point.y / inputGrid.macroHeight) * numMacroX) +
+            (point.x / inputGrid.macroWidth);
+        inputGrid.macroCells[macroIndex].featurePoints.push_back({point.x, point.y, 0});
+    }
+    u_int16_t voronoiID = 0;
+    for (MacroCell& macroCell : inputGrid.macroCells) {
+        for (FeaturePoint& featurePoint : macroCell.featurePoints) {
+            featurePoint.voronoiID = voronoiID;
+            voronoiID++;
+        }
+    }
+    inputGrid.numFeaturePoints = static_cast<int>(points.size());
+
+    // Every grid cell's closest point is within the coverage distance, so the
+    // search only has to reach that many macro cells away
+    inputGrid.coverageDistance = static_cast<int>(std::ceil((1.5f * minDistance) + 1.0f));
+    const int minMacroSize = std::min(inputGrid.macroWidth, inputGrid.macroHeight);
+    inputGrid.searchRadius = (inputGrid.coverageDistance + minMacroSize - 1) / minMacroSize;
+
+    finishVoronoiCells(inputGrid);
+}
+
+void relaxVoronoiCells(VoronoiGrid& inputGrid, const int iterations) {
+    const int numMacroX = inputGrid.width / inputGrid.macroWidth;
+    const int numMacroY = inputGrid.height / inputGrid.macroHeight;
+    std::vector<bool> isDirty(numMacroX * numMacroY);
+    std::vector<bool> shrunkCells(inputGrid.numFeaturePoints, false);
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        std::fill(isDirty.begin(), isDirty.end(), false);
+        bool anyMoved = false;
+        float maxMove = 0.0f;
+
+        for (int macroY = 0; macroY < numMacroY; macroY++) {
+            for (int macroX = 0; macroX < numMacroX; macroX++) {
+                std::vector<FeaturePoint>& featurePoints =
+                    inputGrid.macroCells[(macroY * numMacroX) + macroX].featurePoints;
+
+                for (int i = 0; i < featurePoints.size(); i++) {
+                    FeaturePoint& currentPoint = featurePoints[i];
+                    const VoronoiCellStats& stats = inputGrid.cellStats[currentPoint.voronoiID];
+                    if (stats.count == 0) {
+                        continue;
+                    }
+
+                    // Round the centroid to the nearest grid cell, keeping it
+                    // inside the point's own macro cell
+                    int newX = static_cast<int>(std::lround(
+                        static_cast<double>(stats.sumX) / stats.count));
+                    int newY = static_cast<int>(std::lround(
+                        static_cast<double>(stats.sumY) / stats.count));
+                    newX = std::clamp(newX, macroX * inputGrid.macroWidth,
+                        ((macroX + 1) * inputGrid.macroWidth) - 1);
+                    newY = std::clamp(newY, macroY * inputGrid.macroHeight,
+                        ((macroY + 1) * inputGrid.macroHeight) - 1);
+                    if (newX == currentPoint.x && newY == currentPoint.y) {
+                        continue;
+                    }
+
+                    // Points can only collide with others in the same macro cell
+                    bool duplicatePoint = false;
+                    for (int j = 0; j < featurePoints.size(); j++) {
+                        if (j != i && featurePoints[j].x == newX && featurePoints[j].y == newY) {
+                            duplicatePoint = true;
+                        }
+                    }
+                    if (duplicatePoint) {
+                        continue;
+                    }
+
+                    maxMove = std::max(maxMove, std::hypot(static_cast<float>(newX - currentPoint.x),
+                        static_cast<float>(newY - currentPoint.y)));
+                    currentPoint.x = newX;
+                    currentPoint.y = newY;
+                    anyMoved = true;
+
+                    // Every grid cell that could see this point has to be re-labeled
+                    const int searchRadius = inputGrid.searchRadius;
+                    for (int dirtyY = std::max(macroY - searchRadius, 0);
+                        dirtyY <= std::min(macroY + searchRadius, numMacroY - 1); dirtyY++) {
+                        for (int dirtyX = std::max(macroX - searchRadius, 0);
+                            dirtyX <= std::min(macroX + searchRadius, numMacroX - 1); dirtyX++) {
+                            isDirty[(dirtyY * numMacroX) + dirtyX] = true;
                         }
                     }
                 }
             }
+        }
+
+        if (!anyMoved) {
+            break;
+        }
+
+        // A grid cell's closest point can now be as much further away as the
+        // furthest any point moved. If that pushes the search out another
+        // macro cell, the whole grid has to be re-labeled.
+        if (inputGrid.coverageDistance > 0) {
+            inputGrid.coverageDistance += static_cast<int>(std::ceil(maxMove));
+            const int minMacroSize = std::min(inputGrid.macroWidth, inputGrid.macroHeight);
+            const int searchRadius = (inputGrid.coverageDistance + minMacroSize - 1) / minMacroSize;
+            if (searchRadius != inputGrid.searchRadius) {
+                inputGrid.searchRadius = searchRadius;
+                std::fill(isDirty.begin(), isDirty.end(), true);
+            }
+        }
 
-            // Set the cell's final voronoiID
-            inputGrid.cells[(y * inputGrid.width) + x] = cellID;
+        // Relabel the dirty macro cells in parallel, the same way
+        // finishVoronoiCells() labels them all
+        std::vector<int> dirtyMacroCells;
+        for (int i = 0; i < isDirty.size(); i++) {
+            if (isDirty[i]) {
+                dirtyMacroCells.push_back(i);
+            }
+        }
+        const int numDirty = static_cast<int>(dirtyMacroCells.size());
+        std::vector<MacroCellLabels> macroLabels(numDirty);
+        parallelFor(0, numDirty, LABEL_GRAIN_SIZE, [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                labelMacroCell(inputGrid, dirtyMacroCells[i] % numMacroX,
+                    dirtyMacroCells[i] / numMacroX, true, macroLabels[i]);
+            }
+        });
+        for (const MacroCellLabels& labels : macroLabels) {
+            mergeCellStats(inputGrid.cellStats, labels);
+            for (const u_int16_t cell : labels.shrunkCells) {
+                shrunkCells[cell] = true;
+            }
         }
     }
+
+    // Cells that lost grid cells might have smaller bounds now, which can only
+    // be found by scanning inside their old bounds again
+    parallelFor(0, inputGrid.numFeaturePoints, 256, [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++) {
+            if (!shrunkCells[i]) {
+                continue;
+            }
+            VoronoiCellStats& stats = inputGrid.cellStats[i];
+            const VoronoiCellStats oldStats = stats;
+            stats.minX = stats.minY = std::numeric_limits<int>::max();
+            stats.maxX = stats.maxY = std::numeric_limits<int>::min();
+            for (int y = oldStats.minY; y <= oldStats.maxY; y++) {
+                for (int x = oldStats.minX; x <= oldStats.maxX; x++) {
+                    if (inputGrid.cells[(y * inputGrid.width) + x] == i) {
+                        stats.minX = std::min(stats.minX, x);
+                        stats.minY = std::min(stats.minY, y);
+                        stats.maxX = std::max(stats.maxX, x);
+                        stats.maxY = std::max(stats.maxY, y);
+                    }
+                }
+            }
+        }
+    });
+}
+
+glm::vec2 getCellCentroid(const VoronoiGrid& inputGrid, const u_int16_t voronoiID) {
+    const VoronoiCellStats& stats = inputGrid.cellStats[voronoiID];
+    if (stats.count == 0) {
+        const FeaturePoint* featurePoint = inputGrid.featurePointPointers[voronoiID];
+        return {featurePoint->x + 0.5f, featurePoint->y + 0.5f};
+    }
+
+    // Grid cells are centered half a unit in from their corner
+    return {static_cast<float>(static_cast<double>(stats.sumX) / stats.count) + 0.5f,
+        static_cast<float>(static_cast<double>(stats.sumY) / stats.count) + 0.5f};
 }
 
 VoronoiBitmask generateVoronoiBitmask(const VoronoiGrid& inputGrid, const u_int16_t voronoiID) {
-    // Get the corresponding feature point to the given voronoiID and related coordinates
-    const FeaturePoint* currentFeaturePoint = inputGrid.featurePointPointers[voronoiID];
-    int featureX = currentFeaturePoint->x;
-    int featureY = currentFeaturePoint->y;
-    int macroX = featureX / inputGrid.macroWidth;
-    int macroY = featureY / inputGrid.macroHeight;
-
-    // startingX/Y and endingX/Y are voronoiGrid coords, not bitmask
-    int startingX = (macroX - 1) * inputGrid.macroWidth;
-    int startingY = (macroY - 1) * inputGrid.macroHeight;
-    if (startingX < 0) { startingX = 0; }
-    if (startingY < 0) { startingY = 0; }
-
-    int endingX = ((macroX + 1) * inputGrid.macroWidth)
-                + inputGrid.macroWidth - 1;
-    int endingY = ((macroY + 1) * inputGrid.macroHeight)
-        + inputGrid.macroHeight - 1;
-    if (endingX > inputGrid.width - 1) { endingX = inputGrid.width - 1; }
-    if (endingY > inputGrid.height - 1) { endingY = inputGrid.height - 1; }
+    VoronoiBitmask bitmask;
+    fillVoronoiBitmask(inputGrid, voronoiID, bitmask);
+
+    return bitmask;
+}
+
+void fillVoronoiBitmask(const VoronoiGrid& inputGrid, const u_int16_t voronoiID,
+    VoronoiBitmask& bitmask) {
+    // startingX/Y and endingX/Y are voronoiGrid coords, not bitmask. They're the
+    // exact bounds of the cell, so the bitmask is no bigger than it has to be.
+    const VoronoiCellStats& stats = inputGrid.cellStats[voronoiID];
+    int startingX = stats.minX;
+    int startingY = stats.minY;
+    int endingX = stats.maxX;
+    int endingY = stats.maxY;
+    // An empty cell gets an empty bitmask at its feature point
+    if (stats.count == 0) {
+        startingX = endingX = inputGrid.featurePointPointers[voronoiID]->x;
+        startingY = endingY = inputGrid.featurePointPointers[voronoiID]->y;
+    }
 
     // Interior dimensions (actual cells we want to copy)
     int interiorWidth = (endingX - startingX) + 1;
@@ -156,12 +615,12 @@ VoronoiBitmask generateVoronoiBitmask(const VoronoiGrid& inputGrid, const u_int1
     int paddedWidth = interiorWidth + 2;
     int paddedHeight = interiorHeight + 2;
 
-    VoronoiBitmask bitmask;
+    // assign() keeps the mask's storage when it's already big enough
     bitmask.width = paddedWidth;
     bitmask.height = paddedHeight;
     bitmask.xOffset = startingX;
     bitmask.yOffset = startingY;
-    bitmask.mask.resize(paddedWidth * paddedHeight, false);
+    bitmask.mask.assign(paddedWidth * paddedHeight, false);
 
     // Iterate through the inputGrid to fill the bitmask
     for (int y = startingY; y <= endingY; y++) {
@@ -176,8 +635,6 @@ VoronoiBitmask generateVoronoiBitmask(const VoronoiGrid& inputGrid, const u_int1
             }
         }
     }
-
-    return bitmask;
 }
 
 void printVoronoiGrid(const VoronoiGrid& inputGrid) {
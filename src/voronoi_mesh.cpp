@@ -140,6 +140,11 @@ std::vector<unsigned int> getEarClippedIndices(const std::vector<float>& inputVe
         vertices[i / 3] = glm::vec2(rawVertices[i], rawVertices[i + 1]);
     }
 
+    // Degenerate outlines (like slivers simplified down to a line) have nothing to fill
+    if (vertices.size() < 3) {
+        return {};
+    }
+
     // Make the list of indices, where each index corresponds to a vertex
     std::vector<unsigned int> indices;
     indices.resize(vertices.size());
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <madoc/contour_simplification.h>
+#include <madoc/mesh_optimizer.h>
+#include <madoc/task_scheduler.h>
+#include <madoc/voronoi_mesh.h>
+#include <madoc/world_generator.h>
+
+
+// How far vector cell outlines can be from the grid's labels, which follow
+// them a whole grid cell at a time
+constexpr float VECTOR_CELL_ERROR = 1.0f;
+
+// Places and labels the cells of a gridWidth by gridHeight grid
+static void generateCells(World& world, const WorldSettings& settings, const int gridWidth,
+    const int gridHeight, const float poissonDistance) {
+    world.grid = createVoronoiGrid(gridWidth, gridHeight, settings.macroWidth,
+        settings.macroHeight);
+    if (settings.usePoissonDisk) {
+        generatePoissonDiskCells(world.grid, world.seed, poissonDistance);
+    }
+    else {
+        generateVoronoiCells(world.grid, world.seed, settings.minPoints, settings.maxPoints);
+    }
+    relaxVoronoiCells(world.grid, settings.relaxIterations);
+}
+
+// The vector engine needs the Delaunay triangulation of the feature points
+static void connectCells(World& world, const bool useVectorCells) {
+    if (useVectorCells) {
+        world.triangulation = triangulateFeaturePoints(world.grid);
+        world.cellNeighbors = getDelaunayNeighbors(world.triangulation);
+    }
+    world.cellGraph = useVectorCells ? createCellGraph(world.cellNeighbors) :
+        createGridCellGraph(world.grid);
+}
+
+// Each cell's centroid (gathered while labeling) in world space, and the
+// elevation of the noise there. Hillshading needs the slope there too, which
+// comes out of the same noise samples.
+static void generateElevations(World& world, const bool useHillshading) {
+    world.cellCentroids.resize(world.grid.numFeaturePoints);
+    for (int i = 0; i < world.grid.numFeaturePoints; i++) {
+        const glm::vec2 gridCentroid = getCellCentroid(world.grid, i);
+        world.cellCentroids[i] = glm::vec2(gridCentroid.x, -gridCentroid.y) * world.meshScale;
+    }
+    world.cellElevations = useHillshading ?
+        generateCellElevations(world.cellCentroids, world.seed, world.cellGradients) :
+        generateCellElevations(world.cellCentroids, world.seed);
+}
+
+static void generateBiomes(World& world, const WorldSettings& settings,
+    const BiomeTable& biomeTable) {
+    world.climate = generateClimate(world.cellGraph, world.cellCentroids, world.cellElevations,
+        biomeTable.seaLevel, settings.width, settings.height);
+    classifyBiomes(biomeTable, world.cellElevations, world.climate.temperature,
+        world.climate.precipitation, world.cellBiomes);
+    packBiomeColors(biomeTable, world.cellBiomes, world.cellColors);
+
+    if (settings.useHillshading) {
+        world.cellShades = getHillshades(world.cellElevations, world.cellGradients,
+            biomeTable.seaLevel);
+        for (int i = 0; i < world.grid.numFeaturePoints; i++) {
+            shadeCellColor(world.cellColors, i, world.cellShades[i]);
+        }
+    }
+}
+
+static void generateTables(World& world, const BiomeTable& biomeTable) {
+    world.tables = createSummedAreaTables(world.grid, world.meshScale, world.cellElevations,
+        world.cellBiomes, static_cast<int>(biomeTable.biomes.size()), biomeTable.seaLevel);
+}
+
+static void buildWorldMesh(World& world, const WorldSettings& settings,
+    const BiomeTable& biomeTable, const bool useVectorCells) {
+    const VoronoiGrid& grid = world.grid;
+    const int chunkWidth = std::max(settings.chunkWidth / static_cast<int>(world.meshScale), 1);
+    const int chunkHeight = std::max(settings.chunkHeight / static_cast<int>(world.meshScale), 1);
+    // Vector cells share their corners exactly with their neighbors, so any
+    // corner one of them dropped would open a gap next to it. They get a
+    // single outline level instead of one per tolerance.
+    const std::vector<float> lodTolerances = useVectorCells ?
+        std::vector<float>{VECTOR_CELL_ERROR} : settings.lodTolerances;
+    world.mesh = createWorldMesh(grid.width, grid.height, chunkWidth, chunkHeight,
+        lodTolerances);
+
+    // For each cell, get the vertex and index data for its polygon at every
+    // level of detail. A batch of cells is built in parallel, with each chunk
+    // of the batch going all the way from one reused bitmask to triangles a
+    // cell at a time, then the batch is added to the mesh in cell order, so
+    // the mesh is the same however the work was split.
+    const int numLods = static_cast<int>(lodTolerances.size());
+    const int batchSize = settings.meshBatchSize;
+    std::vector<std::vector<float>> batchVertices(batchSize * numLods);
+    std::vector<std::vector<unsigned int>> batchIndices(batchSize * numLods);
+    for (int batchStart = 0; batchStart < grid.numFeaturePoints; batchStart += batchSize) {
+        const int batchEnd = std::min(batchStart + batchSize, grid.numFeaturePoints);
+        parallelFor(batchStart, batchEnd, settings.meshGrainSize,
+            [&](const int begin, const int end) {
+                VoronoiBitmask cellBitmask;
+                for (int i = begin; i < end; i++) {
+                    std::vector<OutlineChain> chains;
+                    std::vector<float> vectorVertices;
+                    if (useVectorCells) {
+                        vectorVertices = getVoronoiCellVertices(grid, world.triangulation,
+                            world.cellNeighbors[i], i);
+                    }
+                    else {
+                        fillVoronoiBitmask(grid, i, cellBitmask);
+                        chains = getOutlineChains(grid, cellBitmask, i);
+                    }
+
+                    for (int lod = 0; lod < numLods; lod++) {
+                        // Vector cells are convex, so a fan triangulates them.
+                        // Every level gets the same polygon, which only the
+                        // last one can take without copying.
+                        std::vector<float>& currentVertices =
+                            batchVertices[((i - batchStart) * numLods) + lod];
+                        std::vector<unsigned int>& currentIndices =
+                            batchIndices[((i - batchStart) * numLods) + lod];
+                        if (useVectorCells) {
+                            if (lod == numLods - 1) {
+                                currentVertices = std::move(vectorVertices);
+                            }
+                            else {
+                                currentVertices = vectorVertices;
+                            }
+                            currentIndices = getFanIndices(
+                                static_cast<int>(currentVertices.size() / 3));
+                        }
+                        else {
+                            currentVertices = getChainVertices(simplifyOutlineChains(chains,
+                                lodTolerances[lod]));
+                            currentIndices = getEarClippedIndices(currentVertices);
+                        }
+                    }
+                }
+            });
+
+        for (int i = batchStart; i < batchEnd; i++) {
+            // Cells go in the chunk that their feature point is in
+            const FeaturePoint* featurePoint = grid.featurePointPointers[i];
+            const int chunkIndex = getChunkIndex(world.mesh, featurePoint->x, featurePoint->y);
+
+            // Color the cell by the biome its climate makes
+            std::vector<float> currentColor = biomeTable.biomes[world.cellBiomes[i]].color;
+            if (!world.cellShades.empty()) {
+                for (float& channel : currentColor) {
+                    channel *= world.cellShades[i];
+                }
+            }
+
+            for (int lod = 0; lod < numLods; lod++) {
+                addCellToMesh(world.mesh, lod, chunkIndex, i,
+                    batchVertices[((i - batchStart) * numLods) + lod],
+                    batchIndices[((i - batchStart) * numLods) + lod], currentColor);
+            }
+        }
+    }
+    addRasterLodToMesh(world.mesh, grid, world.cellColors);
+    finishWorldMesh(world.mesh);
+
+    // Reorder the triangles for the post-transform cache, then the vertices
+    // for the order they're fetched in. Stats are for the most detailed level.
+    int numDetailedVertices = 0;
+    for (const MeshChunk& chunk : world.mesh.chunks) {
+        numDetailedVertices += chunk.lods[0].numVertices;
+    }
+    std::vector<unsigned int> globalIndices = getGlobalIndices(world.mesh, 0);
+    world.originalACMR = getACMR(globalIndices, VERTEX_CACHE_SIZE);
+    world.originalATVR = getATVR(globalIndices, numDetailedVertices, VERTEX_CACHE_SIZE);
+    optimizeWorldMesh(world.mesh);
+    globalIndices = getGlobalIndices(world.mesh, 0);
+    world.optimizedACMR = getACMR(globalIndices, VERTEX_CACHE_SIZE);
+    world.optimizedATVR = getATVR(globalIndices, numDetailedVertices, VERTEX_CACHE_SIZE);
+}
+
+// Every cell's rainfall covers its whole area
+static void generateRivers(World& world, const WorldSettings& settings,
+    const BiomeTable& biomeTable) {
+    std::vector<float> cellRainfall(world.grid.numFeaturePoints);
+    for (int i = 0; i < world.grid.numFeaturePoints; i++) {
+        cellRainfall[i] = world.climate.rainfall[i] *
+            static_cast<float>(world.grid.cellStats[i].count);
+    }
+    world.hydrology = generateHydrology(world.cellGraph, world.cellElevations,
+        getOutletCells(world.grid, world.cellElevations, biomeTable.seaLevel), cellRainfall);
+    world.riverVertices = getRiverVertices(world.hydrology, world.cellCentroids,
+        world.cellElevations, biomeTable.seaLevel, settings.riverMinFlow);
+}
+
+// Provinces grow over the land cells, then nations grow over the provinces
+static void generateProvinces(World& world, const WorldSettings& settings,
+    const BiomeTable& biomeTable) {
+    world.cellAreas.resize(world.grid.numFeaturePoints);
+    world.isLandCell.resize(world.grid.numFeaturePoints);
+    for (int i = 0; i < world.grid.numFeaturePoints; i++) {
+        world.cellAreas[i] = static_cast<float>(world.grid.cellStats[i].count);
+        world.isLandCell[i] = world.cellElevations[i] >= biomeTable.seaLevel;
+    }
+    world.provinces = generateRegions(world.cellGraph, world.cellCentroids,
+        getTerrainCosts(world.cellElevations, biomeTable), world.cellAreas, world.isLandCell,
+        settings.numProvinces, world.seed);
+    world.nations = generateRegions(world.provinces.regionGraph,
+        world.provinces.regionCentroids, world.provinces.regionCosts,
+        world.provinces.regionAreas, std::vector<bool>(world.provinces.numRegions, true),
+        settings.numNations, world.seed + 1);
+}
+
+World generateWorld(const WorldSettings& settings, const BiomeTable& biomeTable,
+    const int seed) {
+    World world = {};
+    world.seed = seed;
+    world.meshScale = 1.0f;
+
+    // Everything needs the cells, so they come first (and are parallel
+    // inside). Every stage after them is a task that runs as soon as the
+    // stages it needs are done, so stages that don't need each other (like
+    // the triangulation and the noise, or the mesh, the rivers and the
+    // regions) run side by side.
+    generateCells(world, settings, settings.width, settings.height, settings.poissonDistance);
+
+    TaskGraph graph;
+    const int connectTask = addTask(graph, [&]() {
+        connectCells(world, settings.useVectorCells);
+    });
+    const int elevationTask = addTask(graph, [&]() {
+        generateElevations(world, settings.useHillshading);
+    });
+    const int biomeTask = addTask(graph, [&]() {
+        generateBiomes(world, settings, biomeTable);
+    }, {connectTask, elevationTask});
+    addTask(graph, [&]() {
+        buildWorldMesh(world, settings, biomeTable, settings.useVectorCells);
+    }, {biomeTask});
+    // Everything else only the viewer uses
+    if (!settings.isMeshOnly) {
+        addTask(graph, [&]() {
+            generateRivers(world, settings, biomeTable);
+        }, {biomeTask});
+        addTask(graph, [&]() {
+            generateTables(world, biomeTable);
+        }, {biomeTask});
+        const int provinceTask = addTask(graph, [&]() {
+            generateProvinces(world, settings, biomeTable);
+        }, {connectTask, elevationTask});
+
+        // The shared edges between cells never change, only what they separate
+        const int segmentTask = addTask(graph, [&]() {
+            world.borderSegments = settings.useVectorCells ?
+                getVoronoiBorderSegments(world.grid, world.triangulation, world.cellNeighbors) :
+                getGridBorderSegments(world.grid);
+        }, {connectTask});
+        addTask(graph, [&]() {
+            world.borderMesh = createBorderMesh(world.borderSegments, world.isLandCell,
+                world.provinces, world.nations);
+        }, {segmentTask, provinceTask});
+    }
+
+    runTaskGraph(graph);
+
+    return world;
+}
+
+World generatePreviewWorld(const WorldSettings& settings, const BiomeTable& biomeTable,
+    const int seed) {
+    const int scale = settings.previewScale;
+    const int gridWidth = settings.width / scale;
+    const int gridHeight = settings.height / scale;
+    if (gridWidth * scale != settings.width || gridHeight * scale != settings.height ||
+        gridWidth % settings.macroWidth != 0 || gridHeight % settings.macroHeight != 0) {
+        throw std::runtime_error("A " + std::to_string(settings.width) + "x" +
+            std::to_string(settings.height) + " world at preview scale " +
+            std::to_string(scale) + " isn't a whole number of macro cells");
+    }
+
+    World world = {};
+    world.seed = seed;
+    world.meshScale = static_cast<float>(scale);
+
+    // Vector cells are the cheapest outlines there are. The preview is small
+    // enough that the stages just run one after another.
+    generateCells(world, settings, gridWidth, gridHeight, settings.previewPoissonDistance);
+    connectCells(world, true);
+    generateElevations(world, settings.useHillshading);
+    generateBiomes(world, settings, biomeTable);
+    generateTables(world, biomeTable);
+    buildWorldMesh(world, settings, biomeTable, true);
+
+    return world;
+}
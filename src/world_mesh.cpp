@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <madoc/world_mesh.h>
+#include <madoc/mesh_optimizer.h>
+#include <madoc/camera.h>
+
+
+WorldMesh createWorldMesh(const int worldWidth, const int worldHeight,
+    const int chunkWidth, const int chunkHeight, const std::vector<float>& lodTolerances) {
+    WorldMesh mesh;
+    mesh.chunkWidth = chunkWidth;
+    mesh.chunkHeight = chunkHeight;
+    mesh.numChunksX = (worldWidth + chunkWidth - 1) / chunkWidth;
+    mesh.numChunksY = (worldHeight + chunkHeight - 1) / chunkHeight;
+
+    // The raster level is off by up to a whole quad
+    mesh.lodErrors = lodTolerances;
+    mesh.lodErrors.push_back(static_cast<float>(std::max(chunkWidth, chunkHeight)) /
+        RASTER_LOD_RESOLUTION);
+    mesh.numLods = static_cast<int>(mesh.lodErrors.size());
+
+    const int numChunks = mesh.numChunksX * mesh.numChunksY;
+    mesh.chunks.resize(numChunks);
+    for (int i = 0; i < numChunks; i++) {
+        mesh.chunks[i].lods.resize(mesh.numLods);
+    }
+    mesh.stagingVertices.resize(numChunks * mesh.numLods);
+    mesh.stagingCellIDs.resize(numChunks * mesh.numLods);
+    mesh.stagingIndices.resize(numChunks * mesh.numLods);
+
+    return mesh;
+}
+
+int getChunkIndex(const WorldMesh& mesh, const int x, const int y) {
+    const int chunkX = std::clamp(x / mesh.chunkWidth, 0, mesh.numChunksX - 1);
+    const int chunkY = std::clamp(y / mesh.chunkHeight, 0, mesh.numChunksY - 1);
+
+    return (chunkY * mesh.numChunksX) + chunkX;
+}
+
+void addCellToMesh(WorldMesh& mesh, const int lod, const int chunkIndex,
+    const u_int32_t cellID, const std::vector<float>& vertices,
+    const std::vector<unsigned int>& indices, const std::vector<float>& color) {
+    const int staging = (lod * static_cast<int>(mesh.chunks.size())) + chunkIndex;
+    std::vector<float>& stagingVertices = mesh.stagingVertices[staging];
+    std::vector<unsigned int>& stagingIndices = mesh.stagingIndices[staging];
+
+    const unsigned int numPreviousVertices = stagingVertices.size() / 6;
+    for (int i = 0; i < indices.size(); i++) {
+        stagingIndices.push_back(indices[i] + numPreviousVertices);
+    }
+
+    // Add the color to each vertex
+    for (int i = 0; i + 2 < vertices.size(); i += 3) {
+        stagingVertices.insert(stagingVertices.end(), {vertices[i], vertices[i + 1],
+            vertices[i + 2], color[0], color[1], color[2]});
+    }
+    mesh.stagingCellIDs[staging].insert(mesh.stagingCellIDs[staging].end(),
+        vertices.size() / 3, cellID);
+}
+
+void addRasterLodToMesh(WorldMesh& mesh, const VoronoiGrid& inputGrid,
+    const std::vector<u_int8_t>& cellColors) {
+    const int lod = mesh.numLods - 1;
+    const float quadWidth = static_cast<float>(mesh.chunkWidth) / RASTER_LOD_RESOLUTION;
+    const float quadHeight = static_cast<float>(mesh.chunkHeight) / RASTER_LOD_RESOLUTION;
+
+    for (int chunkY = 0; chunkY < mesh.numChunksY; chunkY++) {
+        for (int chunkX = 0; chunkX < mesh.numChunksX; chunkX++) {
+            const int chunkIndex = (chunkY * mesh.numChunksX) + chunkX;
+            for (int quadY = 0; quadY < RASTER_LOD_RESOLUTION; quadY++) {
+                for (int quadX = 0; quadX < RASTER_LOD_RESOLUTION; quadX++) {
+                    // Quads on the far edges of the world get cut short
+                    const float left = (chunkX * mesh.chunkWidth) + (quadX * quadWidth);
+                    const float top = (chunkY * mesh.chunkHeight) + (quadY * quadHeight);
+                    const float right = std::min(left + quadWidth, static_cast<float>(inputGrid.width));
+                    const float bottom = std::min(top + quadHeight, static_cast<float>(inputGrid.height));
+                    if (left >= right || top >= bottom) {
+                        continue;
+                    }
+
+                    // Each quad takes the color of the cell in its middle
+                    const int sampleX = std::min(static_cast<int>((left + right) / 2.0f), inputGrid.width - 1);
+                    const int sampleY = std::min(static_cast<int>((top + bottom) / 2.0f), inputGrid.height - 1);
+                    const u_int16_t cellID = inputGrid.cells[(sampleY * inputGrid.width) + sampleX];
+                    const std::vector<float> color = {cellColors[cellID * 4] / 255.0f,
+                        cellColors[(cellID * 4) + 1] / 255.0f, cellColors[(cellID * 4) + 2] / 255.0f};
+
+                    const std::vector<float> vertices = {left, -top, 0.0f, right, -top, 0.0f,
+                        right, -bottom, 0.0f, left, -bottom, 0.0f};
+                    addCellToMesh(mesh, lod, chunkIndex, cellID, vertices, {0, 1, 2, 0, 2, 3}, color);
+                }
+            }
+        }
+    }
+}
+
+void finishWorldMesh(WorldMesh& mesh) {
+    const int numChunks = static_cast<int>(mesh.chunks.size());
+    // Number of chunks across an origin page
+    const int pageChunksX = std::max(ORIGIN_PAGE_SIZE / mesh.chunkWidth, 1);
+    const int pageChunksY = std::max(ORIGIN_PAGE_SIZE / mesh.chunkHeight, 1);
+
+    for (int i = 0; i < numChunks; i++) {
+        MeshChunk& chunk = mesh.chunks[i];
+
+        // The bounds come from the most detailed level, which all others follow
+        const std::vector<float>& detailedVertices = mesh.stagingVertices[i];
+        chunk.boundsMin = glm::vec2(std::numeric_limits<float>::max());
+        chunk.boundsMax = glm::vec2(std::numeric_limits<float>::lowest());
+        for (int j = 0; j < detailedVertices.size(); j += 6) {
+            chunk.boundsMin = glm::min(chunk.boundsMin, {detailedVertices[j], detailedVertices[j + 1]});
+            chunk.boundsMax = glm::max(chunk.boundsMax, {detailedVertices[j], detailedVertices[j + 1]});
+        }
+
+        // The origin is the middle of the page of chunks this chunk is in
+        const int chunkX = i % mesh.numChunksX;
+        const int chunkY = i / mesh.numChunksX;
+        const int pageStartX = (chunkX / pageChunksX) * pageChunksX * mesh.chunkWidth;
+        const int pageStartY = (chunkY / pageChunksY) * pageChunksY * mesh.chunkHeight;
+        chunk.origin = {pageStartX + ((pageChunksX * mesh.chunkWidth) / 2.0f),
+            -(pageStartY + ((pageChunksY * mesh.chunkHeight) / 2.0f))};
+    }
+
+    // Lay each level out contiguously, so a frame only touches one of them
+    for (int lod = 0; lod < mesh.numLods; lod++) {
+        for (int i = 0; i < numChunks; i++) {
+            const int staging = (lod * numChunks) + i;
+            ChunkLod& chunkLod = mesh.chunks[i].lods[lod];
+            chunkLod.firstIndex = static_cast<int>(mesh.indices.size());
+            chunkLod.numIndices = static_cast<int>(mesh.stagingIndices[staging].size());
+            chunkLod.baseVertex = static_cast<int>(mesh.vertices.size() / 6);
+            chunkLod.numVertices = static_cast<int>(mesh.stagingVertices[staging].size() / 6);
+
+            mesh.vertices.insert(mesh.vertices.end(), mesh.stagingVertices[staging].begin(),
+                mesh.stagingVertices[staging].end());
+            mesh.vertexCellIDs.insert(mesh.vertexCellIDs.end(),
+                mesh.stagingCellIDs[staging].begin(), mesh.stagingCellIDs[staging].end());
+            mesh.indices.insert(mesh.indices.end(), mesh.stagingIndices[staging].begin(),
+                mesh.stagingIndices[staging].end());
+        }
+    }
+
+    // The staging lists aren't needed anymore
+    mesh.stagingVertices = {};
+    mesh.stagingCellIDs = {};
+    mesh.stagingIndices = {};
+}
+
+void optimizeWorldMesh(WorldMesh& mesh) {
+    for (int i = 0; i < mesh.chunks.size(); i++) {
+        for (int lod = 0; lod < mesh.numLods; lod++) {
+            const ChunkLod& chunkLod = mesh.chunks[i].lods[lod];
+            auto indicesStart = mesh.indices.begin() + chunkLod.firstIndex;
+            auto verticesStart = mesh.vertices.begin() + (chunkLod.baseVertex * 6);
+            auto cellIDsStart = mesh.vertexCellIDs.begin() + chunkLod.baseVertex;
+
+            std::vector<unsigned int> chunkIndices(indicesStart,
+                indicesStart + chunkLod.numIndices);
+            chunkIndices = optimizeVertexCache(chunkIndices, chunkLod.numVertices);
+            std::vector<unsigned int> vertexRemap = optimizeVertexFetch(chunkIndices,
+                chunkLod.numVertices);
+
+            std::vector<float> chunkVertices(verticesStart,
+                verticesStart + (chunkLod.numVertices * 6));
+            std::vector<u_int32_t> chunkCellIDs(cellIDsStart,
+                cellIDsStart + chunkLod.numVertices);
+            remapVertices(chunkVertices, 6, vertexRemap);
+            remapVertices(chunkCellIDs, 1, vertexRemap);
+
+            std::copy(chunkIndices.begin(), chunkIndices.end(), indicesStart);
+            std::copy(chunkVertices.begin(), chunkVertices.end(), verticesStart);
+            std::copy(chunkCellIDs.begin(), chunkCellIDs.end(), cellIDsStart);
+        }
+    }
+}
+
+std::vector<unsigned int> getGlobalIndices(const WorldMesh& mesh, const int lod) {
+    std::vector<unsigned int> globalIndices;
+
+    for (int i = 0; i < mesh.chunks.size(); i++) {
+        const ChunkLod& chunkLod = mesh.chunks[i].lods[lod];
+        for (int j = 0; j < chunkLod.numIndices; j++) {
+            globalIndices.push_back(mesh.indices[chunkLod.firstIndex + j] + chunkLod.baseVertex);
+        }
+    }
+
+    return globalIndices;
+}
+
+// Packs a range of vertices that all belong to the same chunk (and so share
+// its origin) and writes it to the same range of the bound VBO
+static void uploadVertexRange(const WorldMesh& mesh, const VertexFormat format,
+    const glm::vec2 origin, const int firstVertex, const int numVertices) {
+    const GLintptr offset = firstVertex * getVertexStride(format);
+    auto verticesStart = mesh.vertices.begin() + (firstVertex * 6);
+    std::vector<float> rangeVertices(verticesStart, verticesStart + (numVertices * 6));
+
+    if (format == COMPACT_VERTEX) {
+        std::vector<CompactVertex> compactVertices = packCompactVertices(rangeVertices, origin);
+        glBufferSubData(GL_ARRAY_BUFFER, offset,
+            compactVertices.size() * sizeof(CompactVertex), compactVertices.data());
+    }
+    else if (format == CELL_ID_VERTEX) {
+        auto cellIDsStart = mesh.vertexCellIDs.begin() + firstVertex;
+        std::vector<u_int32_t> rangeCellIDs(cellIDsStart, cellIDsStart + numVertices);
+        std::vector<CellVertex> cellVertices = packCellVertices(rangeVertices, rangeCellIDs,
+            origin);
+        glBufferSubData(GL_ARRAY_BUFFER, offset,
+            cellVertices.size() * sizeof(CellVertex), cellVertices.data());
+    }
+    else {
+        glBufferSubData(GL_ARRAY_BUFFER, offset,
+            rangeVertices.size() * sizeof(float), rangeVertices.data());
+    }
+}
+
+void uploadWorldMesh(const WorldMesh& mesh, const VertexFormat format, const GLuint VBO,
+    const GLuint EBO) {
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, (mesh.vertices.size() / 6) * getVertexStride(format),
+        nullptr, GL_STATIC_DRAW);
+
+    // Compact formats are packed chunk by chunk, since each has its own origin
+    for (int i = 0; i < mesh.chunks.size(); i++) {
+        const MeshChunk& chunk = mesh.chunks[i];
+        for (int lod = 0; lod < mesh.numLods; lod++) {
+            const ChunkLod& chunkLod = chunk.lods[lod];
+            if (chunkLod.numVertices == 0) {
+                continue;
+            }
+            uploadVertexRange(mesh, format, chunk.origin, chunkLod.baseVertex,
+                chunkLod.numVertices);
+        }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int),
+        mesh.indices.data(), GL_STATIC_DRAW);
+}
+
+void updateWorldMeshVertices(const WorldMesh& mesh, const VertexFormat format,
+    const GLuint VBO, const int firstVertex, const int numVertices) {
+    if (firstVertex < 0 || (firstVertex + numVertices) * 6 > mesh.vertices.size()) {
+        throw std::runtime_error("Vertex range is out of bounds; "
+                                 "cannot update the world mesh.");
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    // The range is split wherever it crosses from one chunk's level of
+    // detail into the next, since they can have different origins
+    const int lastVertex = firstVertex + numVertices;
+    for (const MeshChunk& chunk : mesh.chunks) {
+        for (const ChunkLod& chunkLod : chunk.lods) {
+            const int begin = std::max(firstVertex, chunkLod.baseVertex);
+            const int end = std::min(lastVertex, chunkLod.baseVertex + chunkLod.numVertices);
+            if (begin < end) {
+                uploadVertexRange(mesh, format, chunk.origin, begin, end - begin);
+            }
+        }
+    }
+}
+
+int selectLod(const WorldMesh& mesh, int currentLod, const float pixelsPerUnit) {
+    currentLod = std::clamp(currentLod, 0, mesh.numLods - 1);
+
+    // Go finer once the current level is clearly too coarse, and coarser once
+    // the next level is clearly good enough
+    while (currentLod > 0 && mesh.lodErrors[currentLod] * pixelsPerUnit >
+        LOD_MAX_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS)) {
+        currentLod--;
+    }
+    while (currentLod + 1 < mesh.numLods && mesh.lodErrors[currentLod + 1] * pixelsPerUnit <
+        LOD_MAX_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS)) {
+        currentLod++;
+    }
+
+    return currentLod;
+}
+
+float getLodSwitchZoom(const WorldMesh& mesh, const int lod) {
+    return LOD_MAX_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS) / mesh.lodErrors[lod];
+}
+
+std::vector<int> getVisibleChunks(const WorldMesh& mesh, const glm::vec2 boundsMin,
+    const glm::vec2 boundsMax) {
+    std::vector<int> visibleChunks;
+
+    for (int i = 0; i < mesh.chunks.size(); i++) {
+        const MeshChunk& chunk = mesh.chunks[i];
+        if (chunk.lods[0].numIndices > 0 &&
+            isBoxVisible(chunk.boundsMin, chunk.boundsMax, boundsMin, boundsMax)) {
+            visibleChunks.push_back(i);
+        }
+    }
+
+    return visibleChunks;
+}
+
+void drawWorldMesh(const WorldMesh& mesh, const std::vector<int>& visibleChunks,
+    const int lod, const VertexFormat format, const ShaderUniforms& uniforms) {
+    std::vector<bool> isDrawn(visibleChunks.size(), false);
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+
+    for (int i = 0; i < visibleChunks.size(); i++) {
+        if (isDrawn[i]) {
+            continue;
+        }
+
+        // Batch up every remaining chunk that shares this chunk's origin. Float
+        // vertices don't use the origin, so they all go in one batch.
+        const glm::vec2 origin = mesh.chunks[visibleChunks[i]].origin;
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        for (int j = i; j < visibleChunks.size(); j++) {
+            const MeshChunk& chunk = mesh.chunks[visibleChunks[j]];
+            if (!isDrawn[j] && (format == FLOAT_VERTEX || chunk.origin == origin)) {
+                const ChunkLod& chunkLod = chunk.lods[lod];
+                counts.push_back(chunkLod.numIndices);
+                offsets.push_back(reinterpret_cast<const void*>(
+                    chunkLod.firstIndex * sizeof(unsigned int)));
+                baseVertices.push_back(chunkLod.baseVertex);
+                isDrawn[j] = true;
+            }
+        }
+
+        setVertexFormatUniforms(uniforms, format, origin);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+            offsets.data(), static_cast<GLsizei>(counts.size()), baseVertices.data());
+    }
+}
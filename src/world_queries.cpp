@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+
+#include <madoc/biome_generator.h>
+#include <madoc/task_scheduler.h>
+#include <madoc/world_queries.h>
+
+
+// Rows of the tables are summed in parallel in chunks of this many, then
+// columns in strips of this many
+constexpr int TABLE_ROW_GRAIN_SIZE = 16;
+constexpr int TABLE_COLUMN_GRAIN_SIZE = 64;
+
+int getCellAtPosition(const VoronoiGrid& inputGrid, const float meshScale,
+    const glm::vec2 position) {
+    // World y goes up while grid y goes down
+    const int x = static_cast<int>(std::floor(position.x / meshScale));
+    const int y = static_cast<int>(std::floor(-position.y / meshScale));
+    if (x < 0 || x >= inputGrid.width || y < 0 || y >= inputGrid.height) {
+        return -1;
+    }
+
+    return inputGrid.cells[(y * inputGrid.width) + x];
+}
+
+// Turns a table of row sums (starting at offset) into a summed-area table by
+// adding each row to the one below it, working down strips of columns in
+// parallel
+template <typename T>
+static void sumColumns(std::vector<T>& table, const size_t offset, const int tableWidth,
+    const int tableHeight) {
+    parallelFor(0, tableWidth, TABLE_COLUMN_GRAIN_SIZE, [&](const int begin, const int end) {
+        for (int y = 1; y < tableHeight; y++) {
+            const size_t row = offset + (static_cast<size_t>(y) * tableWidth);
+            for (int x = begin; x < end; x++) {
+                table[row + x] += table[row - tableWidth + x];
+            }
+        }
+    });
+}
+
+SummedAreaTables createSummedAreaTables(const VoronoiGrid& inputGrid, const float meshScale,
+    const std::vector<float>& cellElevations, const std::vector<u_int8_t>& cellBiomes,
+    const int numBiomes, const float seaLevel) {
+    SummedAreaTables tables;
+    tables.width = inputGrid.width;
+    tables.height = inputGrid.height;
+    tables.meshScale = meshScale;
+    tables.numBiomes = numBiomes;
+
+    const int tableWidth = inputGrid.width + 1;
+    const int tableHeight = inputGrid.height + 1;
+    const int tableSize = tableWidth * tableHeight;
+    tables.elevationSums.assign(tableSize, 0.0);
+    tables.landCounts.assign(tableSize, 0);
+    tables.biomeCounts.assign(static_cast<size_t>(numBiomes) * tableSize, 0);
+
+    // Sum along each row first. Every row (and later every column) is added up
+    // in the same order however the work is split, so the sums don't change.
+    parallelFor(0, inputGrid.height, TABLE_ROW_GRAIN_SIZE, [&](const int begin, const int end) {
+        std::vector<u_int32_t> biomeTotals(numBiomes);
+        for (int y = begin; y < end; y++) {
+            double elevationTotal = 0.0;
+            u_int32_t landTotal = 0;
+            std::fill(biomeTotals.begin(), biomeTotals.end(), 0);
+            const int row = (y + 1) * tableWidth;
+
+            for (int x = 0; x < inputGrid.width; x++) {
+                const u_int16_t cell = inputGrid.cells[(y * inputGrid.width) + x];
+                elevationTotal += cellElevations[cell];
+                landTotal += cellElevations[cell] >= seaLevel;
+                biomeTotals[cellBiomes[cell]]++;
+
+                tables.elevationSums[row + x + 1] = elevationTotal;
+                tables.landCounts[row + x + 1] = landTotal;
+                for (int biome = 0; biome < numBiomes; biome++) {
+                    tables.biomeCounts[(static_cast<size_t>(biome) * tableSize) + row + x + 1] =
+                        biomeTotals[biome];
+                }
+            }
+        }
+    });
+
+    sumColumns(tables.elevationSums, 0, tableWidth, tableHeight);
+    sumColumns(tables.landCounts, 0, tableWidth, tableHeight);
+    for (int biome = 0; biome < numBiomes; biome++) {
+        sumColumns(tables.biomeCounts, static_cast<size_t>(biome) * tableSize, tableWidth,
+            tableHeight);
+    }
+
+    return tables;
+}
+
+GridRect getGridRect(const SummedAreaTables& tables, const glm::vec2 boundsMin,
+    const glm::vec2 boundsMax) {
+    // World y goes up while grid y goes down, so the top of the grid
+    // rectangle is the top of the world space one
+    GridRect rect;
+    rect.minX = static_cast<int>(std::floor(boundsMin.x / tables.meshScale));
+    rect.maxX = static_cast<int>(std::ceil(boundsMax.x / tables.meshScale));
+    rect.minY = static_cast<int>(std::floor(-boundsMax.y / tables.meshScale));
+    rect.maxY = static_cast<int>(std::ceil(-boundsMin.y / tables.meshScale));
+
+    rect.minX = std::clamp(rect.minX, 0, tables.width);
+    rect.maxX = std::clamp(rect.maxX, rect.minX, tables.width);
+    rect.minY = std::clamp(rect.minY, 0, tables.height);
+    rect.maxY = std::clamp(rect.maxY, rect.minY, tables.height);
+
+    return rect;
+}
+
+int getRectArea(const GridRect& rect) {
+    return (rect.maxX - rect.minX) * (rect.maxY - rect.minY);
+}
+
+// The total over a rectangle of the table starting at the given offset
+template <typename T>
+static T getRectTotal(const std::vector<T>& table, const size_t offset, const int tableWidth,
+    const GridRect& rect) {
+    const size_t top = offset + (static_cast<size_t>(rect.minY) * tableWidth);
+    const size_t bottom = offset + (static_cast<size_t>(rect.maxY) * tableWidth);
+    return table[bottom + rect.maxX] - table[bottom + rect.minX] -
+        table[top + rect.maxX] + table[top + rect.minX];
+}
+
+float getMeanElevation(const SummedAreaTables& tables, const GridRect& rect) {
+    const int area = getRectArea(rect);
+    if (area == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(
+        getRectTotal(tables.elevationSums, 0, tables.width + 1, rect) / area);
+}
+
+float getLandFraction(const SummedAreaTables& tables, const GridRect& rect) {
+    const int area = getRectArea(rect);
+    if (area == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(getRectTotal(tables.landCounts, 0, tables.width + 1, rect)) /
+        static_cast<float>(area);
+}
+
+int getBiomeCount(const SummedAreaTables& tables, const GridRect& rect, const int biome) {
+    const size_t tableSize = static_cast<size_t>(tables.width + 1) * (tables.height + 1);
+    return static_cast<int>(getRectTotal(tables.biomeCounts, biome * tableSize,
+        tables.width + 1, rect));
+}
+
+std::vector<int> getBiomeHistogram(const SummedAreaTables& tables, const GridRect& rect) {
+    std::vector<int> histogram(tables.numBiomes);
+    for (int biome = 0; biome < tables.numBiomes; biome++) {
+        histogram[biome] = getBiomeCount(tables, rect, biome);
+    }
+
+    return histogram;
+}
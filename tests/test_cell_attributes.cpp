@@ -0,0 +1,192 @@
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <madoc/cell_attributes.h>
+#include <madoc/log_utils.h>
+#include <madoc/shader_utils.h>
+#include <madoc/vertex_format.h>
+
+#include "test_utils.h"
+
+
+// CTest counts a test that exits with this as skipped
+constexpr int SKIP_EXIT_CODE = 77;
+// The target is split into a 2x2 grid of quads, one per cell
+constexpr int TARGET_SIZE = 8;
+// Cells with gaps between their IDs, so a lookup by the wrong index shows
+constexpr std::array<u_int32_t, 4> QUAD_CELLS = {3, 0, 41, 17};
+
+static void* getProcAddress(const char* name) {
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+// Makes an OpenGL 4.1 core context current without any window or surface,
+// returning false if there's no display that can
+static bool createOffscreenContext() {
+    const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay == nullptr) {
+        return false;
+    }
+    const EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+        EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) ||
+        !eglBindAPI(EGL_OPENGL_API)) {
+        return false;
+    }
+
+    // Nothing is ever drawn to a surface, so a display with no configs (like
+    // Mesa's surfaceless one) can still make a context without one
+    const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) ||
+        numConfigs == 0) {
+        config = EGL_NO_CONFIG_KHR;
+    }
+    const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    const EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+        contextAttributes);
+    if (context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        return false;
+    }
+
+    return gladLoadGLLoader(getProcAddress);
+}
+
+// Two triangles per quad covering the target in clip space, with every
+// vertex of a quad carrying that quad's cell ID
+static std::vector<CellVertex> createQuadVertices() {
+    std::vector<float> vertices;
+    std::vector<u_int32_t> cellIDs;
+    for (int i = 0; i < QUAD_CELLS.size(); i++) {
+        const float minX = static_cast<float>(i % 2) - 1.0f;
+        const float minY = static_cast<float>(i / 2) - 1.0f;
+        const std::array<glm::vec2, 6> corners = {glm::vec2(minX, minY),
+            glm::vec2(minX + 1.0f, minY), glm::vec2(minX + 1.0f, minY + 1.0f),
+            glm::vec2(minX, minY), glm::vec2(minX + 1.0f, minY + 1.0f),
+            glm::vec2(minX, minY + 1.0f)};
+        for (const glm::vec2 corner : corners) {
+            vertices.insert(vertices.end(), {corner.x, corner.y, 0.0f, 0.0f, 0.0f, 0.0f});
+            cellIDs.push_back(QUAD_CELLS[i]);
+        }
+    }
+
+    return packCellVertices(vertices, cellIDs, glm::vec2(0.0f));
+}
+
+// Draws the quads and checks each one came out the color its cell has in cellColors
+static void checkQuadColors(const std::vector<u_int8_t>& cellColors, const int numVertices,
+    const std::string& name) {
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLES, 0, numVertices);
+
+    std::vector<u_int8_t> pixels(TARGET_SIZE * TARGET_SIZE * 4);
+    glReadPixels(0, 0, TARGET_SIZE, TARGET_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    expect(glGetError() == GL_NO_ERROR, name + " raised an OpenGL error");
+
+    for (int i = 0; i < QUAD_CELLS.size(); i++) {
+        // The middle of the quad, well away from any edge
+        const int x = ((i % 2) * (TARGET_SIZE / 2)) + (TARGET_SIZE / 4);
+        const int y = ((i / 2) * (TARGET_SIZE / 2)) + (TARGET_SIZE / 4);
+        const u_int8_t* pixel = &pixels[((y * TARGET_SIZE) + x) * 4];
+        const u_int8_t* expected = &cellColors[QUAD_CELLS[i] * 4];
+        for (int channel = 0; channel < 3; channel++) {
+            expect(pixel[channel] == expected[channel], name + ": cell " +
+                std::to_string(QUAD_CELLS[i]) + " drew channel " + std::to_string(channel) +
+                " as " + std::to_string(pixel[channel]) + " instead of " +
+                std::to_string(expected[channel]));
+        }
+    }
+}
+
+int main() {
+    if (!createOffscreenContext()) {
+        logWarning("test_cell_attributes", "No offscreen OpenGL 4.1 context, skipping");
+        return SKIP_EXIT_CODE;
+    }
+
+    try {
+        GLuint framebuffer, renderbuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glGenRenderbuffers(1, &renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+            renderbuffer);
+        expect(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+            "The offscreen framebuffer isn't complete");
+        glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+
+        const GLuint shaderProgram = loadShaderProgram(getShaderSource("vertex.glsl", ""),
+            getShaderSource("fragment.glsl", ""), "");
+        glUseProgram(shaderProgram);
+        const ShaderUniforms uniforms = getShaderUniforms(shaderProgram);
+        const glm::mat4 identity = glm::mat4(1.0f);
+        glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(identity));
+        glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(identity));
+        glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(identity));
+        setVertexFormatUniforms(uniforms, CELL_ID_VERTEX, glm::vec2(0.0f));
+
+        const std::vector<CellVertex> vertices = createQuadVertices();
+        GLuint VAO, VBO;
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(CellVertex), vertices.data(),
+            GL_STATIC_DRAW);
+        setVertexAttributes(CELL_ID_VERTEX);
+
+        // Every cell gets its own color, including the ones no quad uses
+        std::vector<u_int8_t> cellColors;
+        for (int i = 0; i < 48; i++) {
+            packCellColor(cellColors, i, {static_cast<float>(i) / 47.0f,
+                static_cast<float>(i % 5) / 4.0f, 1.0f - (static_cast<float>(i) / 47.0f)});
+        }
+        CellAttributeBuffer cellAttributes = createCellAttributeBuffer(cellColors);
+        bindCellAttributeBuffer(cellAttributes, uniforms.cellColors, 0);
+        const int numVertices = static_cast<int>(vertices.size());
+        checkQuadColors(cellColors, numVertices, "The first draw");
+
+        // Recoloring a range of cells changes only the quads of those cells
+        packCellColor(cellColors, 17, {1.0f, 0.5f, 0.0f});
+        packCellColor(cellColors, 41, {0.0f, 1.0f, 0.25f});
+        updateCellColors(cellAttributes, cellColors, 17, 25);
+        checkQuadColors(cellColors, numVertices, "The draw after recoloring");
+
+        bool isRejected = false;
+        try {
+            updateCellColors(cellAttributes, cellColors, 40, 9);
+        }
+        catch (const std::runtime_error&) {
+            isRejected = true;
+        }
+        expect(isRejected, "Updating colors past the last cell wasn't rejected");
+
+        deleteCellAttributeBuffer(cellAttributes);
+        glDeleteBuffers(1, &VBO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteProgram(shaderProgram);
+        glDeleteRenderbuffers(1, &renderbuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+    catch (const std::runtime_error& error) {
+        logError("test_cell_attributes", error.what());
+        return 1;
+    }
+
+    return 0;
+}
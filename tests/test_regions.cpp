@@ -0,0 +1,145 @@
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <madoc/cell_graph.h>
+#include <madoc/delaunay.h>
+#include <madoc/log_utils.h>
+#include <madoc/regions.h>
+#include <madoc/voronoi.h>
+
+#include "test_utils.h"
+
+
+// A plain one-thread Dijkstra search with the same tie rule as
+// generateRegions: the cheapest region claims each cell, and the lower ID
+// wins a tie. Since the parallel growth settles on the same keys however its
+// updates are ordered, it has to agree with this exactly.
+static std::vector<int> growRegionsSerially(const CellGraph& graph,
+    const std::vector<glm::vec2>& positions, const std::vector<float>& cellCosts,
+    const std::vector<bool>& isClaimable, const std::vector<int>& seedCells) {
+    using Key = std::pair<float, int>;
+    using QueueEntry = std::pair<Key, int>;
+    const Key unreached = {std::numeric_limits<float>::infinity(), -1};
+    std::vector<Key> keys(graph.numCells, unreached);
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> queue;
+    for (int i = 0; i < seedCells.size(); i++) {
+        keys[seedCells[i]] = {0.0f, i};
+        queue.push({keys[seedCells[i]], seedCells[i]});
+    }
+
+    while (!queue.empty()) {
+        const auto [key, cell] = queue.top();
+        queue.pop();
+        if (key != keys[cell]) {
+            continue;
+        }
+        for (int j = graph.offsets[cell]; j < graph.offsets[cell + 1]; j++) {
+            const int neighbor = graph.neighbors[j];
+            const float edgeCost = glm::length(positions[neighbor] - positions[cell]) *
+                (0.5f * (cellCosts[cell] + cellCosts[neighbor]));
+            const Key newKey = {key.first + edgeCost, key.second};
+            if (newKey < keys[neighbor]) {
+                keys[neighbor] = newKey;
+                queue.push({newKey, neighbor});
+            }
+        }
+    }
+
+    std::vector<int> cellRegions(graph.numCells);
+    for (int i = 0; i < graph.numCells; i++) {
+        cellRegions[i] = isClaimable[i] ? keys[i].second : -1;
+    }
+    return cellRegions;
+}
+
+// Grows the regions twice and checks both runs match each other and the
+// serial search
+static void checkRegions(const CellGraph& graph, const std::vector<glm::vec2>& positions,
+    const std::vector<float>& cellCosts, const std::vector<float>& cellAreas,
+    const std::vector<bool>& isClaimable, const int numRegions, const int seed,
+    const std::string& name) {
+    const RegionMap regions = generateRegions(graph, positions, cellCosts, cellAreas,
+        isClaimable, numRegions, seed);
+    const RegionMap again = generateRegions(graph, positions, cellCosts, cellAreas,
+        isClaimable, numRegions, seed);
+    expect(regions.numRegions == numRegions, name + " made the wrong number of regions");
+    expect(again.seedCells == regions.seedCells, name + " picked different seed cells");
+    expect(again.cellRegions == regions.cellRegions, name + " grew differently twice");
+
+    const std::vector<int> expected = growRegionsSerially(graph, positions, cellCosts,
+        isClaimable, regions.seedCells);
+    for (int i = 0; i < graph.numCells; i++) {
+        expect(regions.cellRegions[i] == expected[i], name + " put cell " + std::to_string(i) +
+            " in region " + std::to_string(regions.cellRegions[i]) + " instead of " +
+            std::to_string(expected[i]));
+    }
+}
+
+int main() {
+    try {
+        const int seed = 4817;
+        VoronoiGrid grid = createVoronoiGrid(600, 360, 20, 12);
+        generatePoissonDiskCells(grid, seed, 6.0f);
+        relaxVoronoiCells(grid, 1);
+        const CellGraph graph = createCellGraph(getDelaunayNeighbors(
+            triangulateFeaturePoints(grid)));
+
+        // Terrain that varies from cell to cell, with some cells no region claims
+        std::vector<glm::vec2> positions(grid.numFeaturePoints);
+        std::vector<float> cellAreas(grid.numFeaturePoints);
+        std::vector<float> cellCosts(grid.numFeaturePoints);
+        std::vector<bool> isClaimable(grid.numFeaturePoints);
+        for (int i = 0; i < grid.numFeaturePoints; i++) {
+            positions[i] = getCellCentroid(grid, i);
+            cellAreas[i] = static_cast<float>(grid.cellStats[i].count);
+            const float terrain = std::sin(positions[i].x * 0.03f) *
+                std::cos(positions[i].y * 0.05f);
+            cellCosts[i] = terrain > 0.6f ? MOUNTAIN_TERRAIN_COST : 1.0f;
+            isClaimable[i] = terrain > -0.7f;
+        }
+
+        checkRegions(graph, positions, cellCosts, cellAreas, isClaimable, 120, seed, "Provinces");
+
+        // Nations are grown from the provinces' own graph, like the world generator does
+        const RegionMap provinces = generateRegions(graph, positions, cellCosts, cellAreas,
+            isClaimable, 120, seed);
+        checkRegions(provinces.regionGraph, provinces.regionCentroids, provinces.regionCosts,
+            provinces.regionAreas, std::vector<bool>(provinces.numRegions, true), 10, seed + 1,
+            "Nations");
+
+        // On a lattice where every step costs the same, lots of cells are the
+        // same distance from two seeds, so this checks how ties are broken
+        const int latticeWidth = 80, latticeHeight = 50;
+        std::vector<std::vector<int>> neighborLists(latticeWidth * latticeHeight);
+        std::vector<glm::vec2> latticePositions(latticeWidth * latticeHeight);
+        for (int y = 0; y < latticeHeight; y++) {
+            for (int x = 0; x < latticeWidth; x++) {
+                const int cell = (y * latticeWidth) + x;
+                latticePositions[cell] = glm::vec2(x, y);
+                if (x > 0) {
+                    neighborLists[cell].push_back(cell - 1);
+                    neighborLists[cell - 1].push_back(cell);
+                }
+                if (y > 0) {
+                    neighborLists[cell].push_back(cell - latticeWidth);
+                    neighborLists[cell - latticeWidth].push_back(cell);
+                }
+            }
+        }
+        const int numLatticeCells = latticeWidth * latticeHeight;
+        checkRegions(createCellGraph(neighborLists), latticePositions,
+            std::vector<float>(numLatticeCells, 1.0f), std::vector<float>(numLatticeCells, 1.0f),
+            std::vector<bool>(numLatticeCells, true), 40, seed, "Lattice regions");
+    }
+    catch (const std::runtime_error& error) {
+        logError("test_regions", error.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+
+/*
+ * Fails the test with the given message unless the condition holds. Tests
+ * catch it in main, log it and exit with 1.
+ */
+inline void expect(const bool condition, const std::string& message) {
+    if (!condition) {
+        throw std::runtime_error(message);
+    }
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <madoc/log_utils.h>
+#include <madoc/voronoi.h>
+#include <madoc/world_queries.h>
+
+#include "test_utils.h"
+
+
+constexpr float MESH_SCALE = 2.0f;
+constexpr float SEA_LEVEL = 0.4f;
+constexpr int NUM_BIOMES = 5;
+constexpr int NUM_RANDOM_RECTS = 500;
+
+// The summed-area answers for a rectangle against adding up every grid cell in it
+static void checkRect(const SummedAreaTables& tables, const VoronoiGrid& grid,
+    const std::vector<float>& cellElevations, const std::vector<u_int8_t>& cellBiomes,
+    const GridRect& rect) {
+    const std::string name = "Rectangle (" + std::to_string(rect.minX) + ", " +
+        std::to_string(rect.minY) + ") to (" + std::to_string(rect.maxX) + ", " +
+        std::to_string(rect.maxY) + ")";
+
+    double elevationTotal = 0.0;
+    int landCount = 0;
+    std::vector<int> histogram(NUM_BIOMES);
+    for (int y = rect.minY; y < rect.maxY; y++) {
+        for (int x = rect.minX; x < rect.maxX; x++) {
+            const u_int16_t cell = grid.cells[(y * grid.width) + x];
+            elevationTotal += cellElevations[cell];
+            landCount += cellElevations[cell] >= SEA_LEVEL;
+            histogram[cellBiomes[cell]]++;
+        }
+    }
+
+    const int area = getRectArea(rect);
+    const float meanElevation = area == 0 ? 0.0f : static_cast<float>(elevationTotal / area);
+    const float landFraction = area == 0 ? 0.0f :
+        static_cast<float>(landCount) / static_cast<float>(area);
+    expect(std::abs(getMeanElevation(tables, rect) - meanElevation) < 1e-5f,
+        name + " has mean elevation " + std::to_string(getMeanElevation(tables, rect)) +
+        " instead of " + std::to_string(meanElevation));
+    expect(getLandFraction(tables, rect) == landFraction, name + " has the wrong land fraction");
+    expect(getBiomeHistogram(tables, rect) == histogram, name + " has the wrong biome counts");
+    for (int biome = 0; biome < NUM_BIOMES; biome++) {
+        expect(getBiomeCount(tables, rect, biome) == histogram[biome],
+            name + " has the wrong count of biome " + std::to_string(biome));
+    }
+}
+
+int main() {
+    try {
+        const int seed = 2291;
+        VoronoiGrid grid = createVoronoiGrid(300, 200, 30, 20);
+        generateVoronoiCells(grid, seed, 2, 5);
+
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> elevation(0.0f, 1.0f);
+        std::uniform_int_distribution<int> biome(0, NUM_BIOMES - 1);
+        std::vector<float> cellElevations(grid.numFeaturePoints);
+        std::vector<u_int8_t> cellBiomes(grid.numFeaturePoints);
+        for (int i = 0; i < grid.numFeaturePoints; i++) {
+            cellElevations[i] = elevation(generator);
+            cellBiomes[i] = static_cast<u_int8_t>(biome(generator));
+        }
+
+        const SummedAreaTables tables = createSummedAreaTables(grid, MESH_SCALE,
+            cellElevations, cellBiomes, NUM_BIOMES, SEA_LEVEL);
+
+        // The edge cases, then rectangles anywhere on the grid
+        checkRect(tables, grid, cellElevations, cellBiomes, {0, 0, grid.width, grid.height});
+        checkRect(tables, grid, cellElevations, cellBiomes, {0, 0, 1, 1});
+        checkRect(tables, grid, cellElevations, cellBiomes,
+            {grid.width - 1, grid.height - 1, grid.width, grid.height});
+        checkRect(tables, grid, cellElevations, cellBiomes, {10, 10, 10, 40});
+        std::uniform_int_distribution<int> gridX(0, grid.width);
+        std::uniform_int_distribution<int> gridY(0, grid.height);
+        for (int i = 0; i < NUM_RANDOM_RECTS; i++) {
+            const int x0 = gridX(generator), x1 = gridX(generator);
+            const int y0 = gridY(generator), y1 = gridY(generator);
+            checkRect(tables, grid, cellElevations, cellBiomes,
+                {std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1)});
+        }
+
+        // World space rectangles are clipped to the world, and y goes up
+        const GridRect clipped = getGridRect(tables, glm::vec2(-50.0f, -1000.0f),
+            glm::vec2(1000.0f, 50.0f));
+        expect(clipped.minX == 0 && clipped.minY == 0 && clipped.maxX == grid.width &&
+            clipped.maxY == grid.height, "A rectangle around the world isn't clipped to it");
+        const GridRect inner = getGridRect(tables, glm::vec2(4.0f, -9.0f), glm::vec2(7.0f, -2.0f));
+        expect(inner.minX == 2 && inner.minY == 1 && inner.maxX == 4 && inner.maxY == 5,
+            "A world space rectangle covers the wrong grid cells");
+
+        for (int y = 0; y < grid.height; y++) {
+            for (int x = 0; x < grid.width; x++) {
+                const glm::vec2 position = glm::vec2(x + 0.5f, -(y + 0.5f)) * MESH_SCALE;
+                expect(getCellAtPosition(grid, MESH_SCALE, position) ==
+                    grid.cells[(y * grid.width) + x], "The wrong cell is at a position");
+            }
+        }
+        expect(getCellAtPosition(grid, MESH_SCALE, glm::vec2(-1.0f, -1.0f)) == -1 &&
+            getCellAtPosition(grid, MESH_SCALE, glm::vec2(1.0f, 1.0f)) == -1,
+            "There's a cell off the world");
+    }
+    catch (const std::runtime_error& error) {
+        logError("test_world_queries", error.what());
+        return 1;
+    }
+
+    return 0;
+}